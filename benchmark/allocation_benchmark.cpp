@@ -0,0 +1,98 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_scene.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+// every allocation of the benchmark executable, counted by the replaced operator new below
+std::atomic<uint64_t> allocation_count{0};
+}  // namespace
+
+// none of them is inlined, otherwise gcc warns about mismatched new and delete at the call sites
+__attribute__((noinline)) void * operator new(std::size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void * ptr) noexcept { std::free(ptr); }
+
+__attribute__((noinline)) void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace
+{
+using traffic_mirror::DetectedRoi;
+using traffic_mirror::DetectionEngine;
+using traffic_mirror::PoseBundle;
+using traffic_mirror::RoughRoiMode;
+using traffic_mirror::SpatialGrid;
+using traffic_mirror::TrafficMirrorTable;
+using traffic_mirror::synthetic::CameraModel;
+
+// args: traffic mirror num, pose sample num, camera model, rough roi mode. Fails if detect
+// allocates once the buffers of the engine and the output have grown to the frame
+void BM_DetectAllocations(benchmark::State & state)
+{
+  const TrafficMirrorTable table =
+    traffic_mirror::synthetic::makeTrafficMirrorTable(state.range(0));
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  const auto model = static_cast<CameraModel>(state.range(2));
+  const auto mode = static_cast<RoughRoiMode>(state.range(3));
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(mode));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  std::vector<DetectedRoi> rois;
+  // warm-up frame
+  engine.detect(table, grid, poses, rois);
+
+  uint64_t allocations = 0;
+  for (auto _ : state) {
+    rois.clear();
+    const uint64_t count_before = allocation_count.load(std::memory_order_relaxed);
+    engine.detect(table, grid, poses, rois);
+    allocations += allocation_count.load(std::memory_order_relaxed) - count_before;
+    benchmark::DoNotOptimize(rois.data());
+  }
+  state.SetLabel(
+    std::string(traffic_mirror::synthetic::toString(model)) +
+    (mode == RoughRoiMode::Sampling ? "/sampling" : "/analytic"));
+  state.counters["allocations"] =
+    benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+  state.counters["rois"] = static_cast<double>(rois.size());
+  if (allocations > 0) {
+    state.SkipWithError("detect allocates in the steady state");
+  }
+}
+}  // namespace
+
+// the models CameraProjector supports, the fallback projection is up to the caller
+BENCHMARK(BM_DetectAllocations)
+  ->ArgNames({"mirrors", "samples", "camera", "mode"})
+  ->ArgsProduct({{10, 1000, 100000}, {1, 20}, {0, 1, 2}, {0, 1}});
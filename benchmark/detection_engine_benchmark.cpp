@@ -0,0 +1,239 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_scene.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::CameraProjector;
+using traffic_mirror::DetectedRoi;
+using traffic_mirror::DetectionEngine;
+using traffic_mirror::PoseBundle;
+using traffic_mirror::RoughRoiMode;
+using traffic_mirror::SpatialGrid;
+using traffic_mirror::TrafficMirrorTable;
+using traffic_mirror::synthetic::CameraModel;
+
+struct Scene
+{
+  TrafficMirrorTable table;
+  SpatialGrid grid;
+};
+
+/**
+ * @brief the scenes are built once per table size and shared by the benchmarks
+ *
+ */
+const Scene & getScene(const size_t n)
+{
+  static std::map<size_t, std::unique_ptr<Scene>> scenes;
+  auto & scene = scenes[n];
+  if (!scene) {
+    scene = std::make_unique<Scene>();
+    scene->table = traffic_mirror::synthetic::makeTrafficMirrorTable(n);
+    scene->grid = SpatialGrid(scene->table.center_x, scene->table.center_y, 200.0);
+  }
+  return *scene;
+}
+
+void setLabel(benchmark::State & state, const CameraModel model, const RoughRoiMode mode)
+{
+  state.SetLabel(
+    std::string(traffic_mirror::synthetic::toString(model)) +
+    (mode == RoughRoiMode::Sampling ? "/sampling" : "/analytic"));
+}
+
+/**
+ * @brief mean area of the rough rois in pixels, 0 without rois
+ *
+ */
+double getMeanRoughRoiArea(const std::vector<DetectedRoi> & rois)
+{
+  if (rois.empty()) {
+    return 0.0;
+  }
+  double area = 0.0;
+  for (const auto & roi : rois) {
+    area += static_cast<double>(roi.rough_roi.width) * roi.rough_roi.height;
+  }
+  return area / static_cast<double>(rois.size());
+}
+
+// args: traffic mirror num, pose sample num
+void BM_GetCandidateTrafficMirrors(benchmark::State & state)
+{
+  const Scene & scene = getScene(state.range(0));
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling));
+  std::vector<size_t> candidates;
+  for (auto _ : state) {
+    candidates.clear();
+    engine.getCandidateTrafficMirrors(scene.grid, poses, candidates);
+    benchmark::DoNotOptimize(candidates.data());
+  }
+  state.counters["candidates"] = static_cast<double>(candidates.size());
+}
+
+// args: traffic mirror num, pose sample num
+void BM_GetVisibleTrafficMirrors(benchmark::State & state)
+{
+  const Scene & scene = getScene(state.range(0));
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::PlumbBob));
+  std::vector<size_t> candidates;
+  engine.getCandidateTrafficMirrors(scene.grid, poses, candidates);
+  std::vector<size_t> visible;
+  for (auto _ : state) {
+    visible.clear();
+    engine.getVisibleTrafficMirrors(scene.table, candidates, poses, visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * candidates.size());
+  state.counters["candidates"] = static_cast<double>(candidates.size());
+  state.counters["visible"] = static_cast<double>(visible.size());
+}
+
+// args: traffic mirror num, pose sample num, camera model, rough roi mode
+void BM_GetTrafficMirrorRois(benchmark::State & state)
+{
+  const Scene & scene = getScene(state.range(0));
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  const auto model = static_cast<CameraModel>(state.range(2));
+  const auto mode = static_cast<RoughRoiMode>(state.range(3));
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(mode));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  std::vector<size_t> candidates;
+  engine.getCandidateTrafficMirrors(scene.grid, poses, candidates);
+  std::vector<size_t> visible;
+  engine.getVisibleTrafficMirrors(scene.table, candidates, poses, visible);
+  std::vector<DetectedRoi> rois;
+  for (auto _ : state) {
+    rois.clear();
+    engine.getTrafficMirrorRois(scene.table, visible, poses, rois);
+    benchmark::DoNotOptimize(rois.data());
+  }
+  setLabel(state, model, mode);
+  state.SetItemsProcessed(state.iterations() * visible.size());
+  state.counters["visible"] = static_cast<double>(visible.size());
+  state.counters["rois"] = static_cast<double>(rois.size());
+  // tightness of the rough rois, to weigh the cost of each mode against the image area it leaves
+  // to the detector
+  state.counters["roi_area"] = getMeanRoughRoiArea(rois);
+}
+
+// args: visible traffic mirror num, pose sample num, rough roi mode, batch projection. The same
+// plumb_bob rois through the batched projection and one traffic mirror at a time
+void BM_GetTrafficMirrorRoisPath(benchmark::State & state)
+{
+  const Scene & scene = getScene(100000);
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  const auto mode = static_cast<RoughRoiMode>(state.range(2));
+  const bool batch_projection = state.range(3) != 0;
+  traffic_mirror::DetectionConfig config = traffic_mirror::synthetic::makeDetectionConfig(mode);
+  config.batch_projection = batch_projection;
+  DetectionEngine engine(config);
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::PlumbBob));
+  std::vector<size_t> candidates;
+  engine.getCandidateTrafficMirrors(scene.grid, poses, candidates);
+  std::vector<size_t> all_visible;
+  engine.getVisibleTrafficMirrors(scene.table, candidates, poses, all_visible);
+  // the visible traffic mirrors are repeated to reach the count
+  std::vector<size_t> visible;
+  for (int64_t i = 0; i < state.range(0) && !all_visible.empty(); ++i) {
+    visible.push_back(all_visible[i % all_visible.size()]);
+  }
+  std::vector<DetectedRoi> rois;
+  for (auto _ : state) {
+    rois.clear();
+    engine.getTrafficMirrorRois(scene.table, visible, poses, rois);
+    benchmark::DoNotOptimize(rois.data());
+  }
+  state.SetLabel(
+    std::string(mode == RoughRoiMode::Sampling ? "sampling" : "analytic") +
+    (batch_projection ? "/batch" : "/scalar"));
+  state.SetItemsProcessed(state.iterations() * visible.size());
+  state.counters["rois"] = static_cast<double>(rois.size());
+}
+
+// args: traffic mirror num, pose sample num, camera model, rough roi mode
+void BM_Detect(benchmark::State & state)
+{
+  const Scene & scene = getScene(state.range(0));
+  const PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  const auto model = static_cast<CameraModel>(state.range(2));
+  const auto mode = static_cast<RoughRoiMode>(state.range(3));
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(mode));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  std::vector<DetectedRoi> rois;
+  for (auto _ : state) {
+    rois.clear();
+    engine.detect(scene.table, scene.grid, poses, rois);
+    benchmark::DoNotOptimize(rois.data());
+  }
+  setLabel(state, model, mode);
+  state.counters["rois"] = static_cast<double>(rois.size());
+}
+
+// args: camera model. The inline projection of CameraProjector, see BM_ImageGeometryRawProjection
+// for the image_geometry projection it replaces
+void BM_CameraProjectorProjectToRaw(benchmark::State & state)
+{
+  const auto model = static_cast<CameraModel>(state.range(0));
+  const CameraProjector projector(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  const std::vector<Eigen::Vector3d> points = traffic_mirror::synthetic::makeCameraPoints(1024);
+  for (auto _ : state) {
+    for (const auto & point : points) {
+      double u = 0.0;
+      double v = 0.0;
+      projector.projectToRaw(point.x(), point.y(), point.z(), u, v);
+      benchmark::DoNotOptimize(u);
+      benchmark::DoNotOptimize(v);
+    }
+  }
+  state.SetLabel(traffic_mirror::synthetic::toString(model));
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+
+const std::vector<int64_t> traffic_mirror_nums{10, 1000, 10000, 100000};
+const std::vector<int64_t> pose_sample_nums{1, 5, 20, 50};
+const std::vector<int64_t> camera_models{
+  static_cast<int64_t>(CameraModel::Pinhole), static_cast<int64_t>(CameraModel::PlumbBob),
+  static_cast<int64_t>(CameraModel::RationalPolynomial)};
+const std::vector<int64_t> rough_roi_modes{
+  static_cast<int64_t>(RoughRoiMode::Sampling), static_cast<int64_t>(RoughRoiMode::Analytic)};
+}  // namespace
+
+BENCHMARK(BM_GetCandidateTrafficMirrors)
+  ->ArgNames({"mirrors", "samples"})
+  ->ArgsProduct({traffic_mirror_nums, pose_sample_nums});
+BENCHMARK(BM_GetVisibleTrafficMirrors)
+  ->ArgNames({"mirrors", "samples"})
+  ->ArgsProduct({traffic_mirror_nums, pose_sample_nums});
+BENCHMARK(BM_GetTrafficMirrorRois)
+  ->ArgNames({"mirrors", "samples", "camera", "mode"})
+  ->ArgsProduct({traffic_mirror_nums, pose_sample_nums, camera_models, rough_roi_modes});
+BENCHMARK(BM_GetTrafficMirrorRoisPath)
+  ->ArgNames({"visible", "samples", "mode", "batch"})
+  ->ArgsProduct({{10, 100, 1000}, {1, 20}, rough_roi_modes, {0, 1}});
+BENCHMARK(BM_Detect)
+  ->ArgNames({"mirrors", "samples", "camera", "mode"})
+  ->ArgsProduct({traffic_mirror_nums, {1, 20}, camera_models, rough_roi_modes});
+BENCHMARK(BM_CameraProjectorProjectToRaw)->ArgNames({"camera"})->DenseRange(0, 2);
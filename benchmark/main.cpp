@@ -0,0 +1,40 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// same as BENCHMARK_MAIN, but the results are written as JSON unless another format is requested
+int main(int argc, char ** argv)
+{
+  std::vector<char *> args(argv, argv + argc);
+  const bool has_format = std::any_of(args.begin(), args.end(), [](const char * arg) {
+    return std::strncmp(arg, "--benchmark_format", std::strlen("--benchmark_format")) == 0;
+  });
+  char json_format[] = "--benchmark_format=json";
+  if (!has_format) {
+    args.push_back(json_format);
+  }
+  int arg_num = static_cast<int>(args.size());
+  benchmark::Initialize(&arg_num, args.data());
+  if (benchmark::ReportUnrecognizedArguments(arg_num, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
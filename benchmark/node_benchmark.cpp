@@ -0,0 +1,122 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_camera_info.hpp"
+#include "synthetic_scene.hpp"
+#include "traffic_mirror_map_based_detector/debug_markers.hpp"
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <sensor_msgs/msg/camera_info.hpp>
+
+#include <vector>
+
+namespace
+{
+using traffic_mirror::synthetic::CameraModel;
+using traffic_mirror::synthetic::makeCameraInfo;
+
+// args: camera model. The image_geometry projection of the fallback path of the node
+void BM_ImageGeometryRawProjection(benchmark::State & state)
+{
+  const auto model = static_cast<CameraModel>(state.range(0));
+  image_geometry::PinholeCameraModel pinhole_camera_model;
+  pinhole_camera_model.fromCameraInfo(
+    makeCameraInfo(traffic_mirror::synthetic::makeCameraIntrinsics(model)));
+  const traffic_mirror::RawProjection projection =
+    traffic_mirror::makeRawProjection(pinhole_camera_model);
+  const std::vector<Eigen::Vector3d> points = traffic_mirror::synthetic::makeCameraPoints(1024);
+  for (auto _ : state) {
+    for (const auto & point : points) {
+      double u = 0.0;
+      double v = 0.0;
+      projection(point.x(), point.y(), point.z(), u, v);
+      benchmark::DoNotOptimize(u);
+      benchmark::DoNotOptimize(v);
+    }
+  }
+  state.SetLabel(traffic_mirror::synthetic::toString(model));
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+
+// args: traffic mirror num, pose sample num, rough roi mode. The whole frame of an equidistant
+// camera, which CameraProjector does not cover: the node projects it one point at a time through
+// image_geometry
+void BM_DetectFallback(benchmark::State & state)
+{
+  const traffic_mirror::TrafficMirrorTable table =
+    traffic_mirror::synthetic::makeTrafficMirrorTable(state.range(0));
+  const traffic_mirror::SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  const traffic_mirror::PoseBundle poses =
+    traffic_mirror::synthetic::makePoseBundle(state.range(1));
+  const auto mode = static_cast<traffic_mirror::RoughRoiMode>(state.range(2));
+  const sensor_msgs::msg::CameraInfo camera_info =
+    makeCameraInfo(traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::Equidistant));
+  image_geometry::PinholeCameraModel pinhole_camera_model;
+  pinhole_camera_model.fromCameraInfo(camera_info);
+  traffic_mirror::DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(mode));
+  engine.setCamera(
+    traffic_mirror::makeCameraIntrinsics(camera_info),
+    traffic_mirror::makeRawProjection(pinhole_camera_model));
+  if (engine.isProjectorSupported()) {
+    state.SkipWithError("the camera does not take the fallback projection");
+    return;
+  }
+  std::vector<traffic_mirror::DetectedRoi> rois;
+  for (auto _ : state) {
+    rois.clear();
+    engine.detect(table, grid, poses, rois);
+    benchmark::DoNotOptimize(rois.data());
+  }
+  state.SetLabel(mode == traffic_mirror::RoughRoiMode::Sampling ? "sampling" : "analytic");
+  state.counters["rois"] = static_cast<double>(rois.size());
+}
+
+// args: traffic mirror num. The markers of publishVisibleTrafficMirrors
+void BM_MakeVisibleTrafficMirrorMarkers(benchmark::State & state)
+{
+  const traffic_mirror::TrafficMirrorTable table =
+    traffic_mirror::synthetic::makeTrafficMirrorTable(state.range(0));
+  const traffic_mirror::SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  const traffic_mirror::PoseBundle poses = traffic_mirror::synthetic::makePoseBundle(1);
+  traffic_mirror::DetectionEngine engine(
+    traffic_mirror::synthetic::makeDetectionConfig(traffic_mirror::RoughRoiMode::Sampling));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::PlumbBob));
+  std::vector<size_t> candidates;
+  engine.getCandidateTrafficMirrors(grid, poses, candidates);
+  std::vector<size_t> visible;
+  engine.getVisibleTrafficMirrors(table, candidates, poses, visible);
+  const std_msgs::msg::Header header =
+    makeCameraInfo(traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::PlumbBob)).header;
+  for (auto _ : state) {
+    const visualization_msgs::msg::MarkerArray markers =
+      traffic_mirror::makeVisibleTrafficMirrorMarkers(poses.samples[0], header, table, visible);
+    benchmark::DoNotOptimize(markers.markers.data());
+  }
+  state.SetItemsProcessed(state.iterations() * visible.size());
+  state.counters["visible"] = static_cast<double>(visible.size());
+}
+}  // namespace
+
+BENCHMARK(BM_ImageGeometryRawProjection)->ArgNames({"camera"})->DenseRange(0, 3);
+BENCHMARK(BM_DetectFallback)
+  ->ArgNames({"mirrors", "samples", "mode"})
+  ->ArgsProduct({{10, 1000, 10000, 100000}, {1, 20}, {0, 1}});
+BENCHMARK(BM_MakeVisibleTrafficMirrorMarkers)
+  ->ArgNames({"mirrors"})
+  ->Arg(10)
+  ->Arg(1000)
+  ->Arg(10000)
+  ->Arg(100000);
@@ -0,0 +1,53 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYNTHETIC_CAMERA_INFO_HPP_
+#define SYNTHETIC_CAMERA_INFO_HPP_
+
+#include "traffic_mirror_map_based_detector/camera_projector.hpp"
+
+#include <sensor_msgs/msg/camera_info.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace traffic_mirror::synthetic
+{
+/**
+ * @brief camera_info of the intrinsics, the inverse of traffic_mirror::makeCameraIntrinsics. The
+ * ROS side of the synthetic scenes, kept out of synthetic_scene.hpp, which does not depend on ROS
+ *
+ */
+inline sensor_msgs::msg::CameraInfo makeCameraInfo(
+  const CameraIntrinsics & intrinsics, const std::string & frame_id = "camera")
+{
+  sensor_msgs::msg::CameraInfo camera_info;
+  camera_info.header.frame_id = frame_id;
+  camera_info.width = intrinsics.width;
+  camera_info.height = intrinsics.height;
+  camera_info.binning_x = intrinsics.binning_x;
+  camera_info.binning_y = intrinsics.binning_y;
+  camera_info.roi.x_offset = intrinsics.roi_x_offset;
+  camera_info.roi.y_offset = intrinsics.roi_y_offset;
+  camera_info.roi.width = intrinsics.roi_width;
+  camera_info.roi.height = intrinsics.roi_height;
+  camera_info.distortion_model = intrinsics.distortion_model;
+  camera_info.d = intrinsics.d;
+  std::copy(intrinsics.k.begin(), intrinsics.k.end(), camera_info.k.begin());
+  std::copy(intrinsics.r.begin(), intrinsics.r.end(), camera_info.r.begin());
+  std::copy(intrinsics.p.begin(), intrinsics.p.end(), camera_info.p.begin());
+  return camera_info;
+}
+}  // namespace traffic_mirror::synthetic
+#endif  // SYNTHETIC_CAMERA_INFO_HPP_
@@ -0,0 +1,211 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYNTHETIC_SCENE_HPP_
+#define SYNTHETIC_SCENE_HPP_
+
+#include "traffic_mirror_map_based_detector/camera_projector.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/spatial_grid.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace traffic_mirror::synthetic
+{
+/**
+ * @brief camera models of the benchmarks. Equidistant is not covered by CameraProjector and goes
+ * through the fallback projection
+ *
+ */
+enum class CameraModel : int64_t {
+  Pinhole = 0,
+  PlumbBob = 1,
+  RationalPolynomial = 2,
+  Equidistant = 3,
+};
+
+inline const char * toString(const CameraModel model)
+{
+  switch (model) {
+    case CameraModel::Pinhole:
+      return "pinhole";
+    case CameraModel::PlumbBob:
+      return "plumb_bob";
+    case CameraModel::RationalPolynomial:
+      return "rational_polynomial";
+    case CameraModel::Equidistant:
+      return "equidistant";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief 1920x1080 camera with a horizontal field of view of about 90 degrees
+ *
+ */
+inline CameraIntrinsics makeCameraIntrinsics(const CameraModel model)
+{
+  CameraIntrinsics intrinsics;
+  intrinsics.width = 1920;
+  intrinsics.height = 1080;
+  intrinsics.k = {960.0, 0.0, 960.0, 0.0, 960.0, 540.0, 0.0, 0.0, 1.0};
+  intrinsics.r = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  intrinsics.p = {960.0, 0.0, 960.0, 0.0, 0.0, 960.0, 540.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  switch (model) {
+    case CameraModel::Pinhole:
+      intrinsics.distortion_model = "plumb_bob";
+      intrinsics.d = {0.0, 0.0, 0.0, 0.0, 0.0};
+      break;
+    case CameraModel::PlumbBob:
+      intrinsics.distortion_model = "plumb_bob";
+      intrinsics.d = {-0.1, 0.01, 0.001, 0.001, 0.0};
+      break;
+    case CameraModel::RationalPolynomial:
+      intrinsics.distortion_model = "rational_polynomial";
+      intrinsics.d = {-0.1, 0.01, 0.001, 0.001, 0.0, 0.05, -0.01, 0.001};
+      break;
+    case CameraModel::Equidistant:
+      intrinsics.distortion_model = "equidistant";
+      intrinsics.d = {-0.01, 0.001, 0.0, 0.0};
+      break;
+  }
+  return intrinsics;
+}
+
+/**
+ * @brief side of the square the traffic mirrors are spread over, centered on the camera. The
+ * density, and so the number of visible traffic mirrors, grows with the table size
+ *
+ */
+constexpr double scene_size = 1000.0;
+
+/**
+ * @brief Traffic mirrors of 1 m x 0.8 m at random positions, heights and facing directions
+ *
+ * @param n      number of traffic mirrors
+ * @param seed   seed of the generator, the same seed gives the same table
+ */
+inline TrafficMirrorTable makeTrafficMirrorTable(const size_t n, const uint32_t seed = 1)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> position(-0.5 * scene_size, 0.5 * scene_size);
+  std::uniform_real_distribution<double> height(2.0, 5.0);
+  std::uniform_real_distribution<double> yaw_distribution(-M_PI, M_PI);
+
+  TrafficMirrorTable table;
+  table.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const double x = position(rng);
+    const double y = position(rng);
+    const double z = height(rng);
+    const double yaw = yaw_distribution(rng);
+    // the line string runs to the right of the facing direction
+    const double dx = 0.5 * std::cos(yaw - M_PI_2);
+    const double dy = 0.5 * std::sin(yaw - M_PI_2);
+    table.ids.push_back(static_cast<int64_t>(i));
+    table.top_left_x.push_back(x - dx);
+    table.top_left_y.push_back(y - dy);
+    table.top_left_z.push_back(z + 0.8);
+    table.bottom_right_x.push_back(x + dx);
+    table.bottom_right_y.push_back(y + dy);
+    table.bottom_right_z.push_back(z);
+    table.center_x.push_back(x);
+    table.center_y.push_back(y);
+    table.center_z.push_back(z + 0.4);
+    table.facing_x.push_back(std::cos(yaw));
+    table.facing_y.push_back(std::sin(yaw));
+    table.is_valid.push_back(1);
+    table.lanelet_offsets.push_back(table.lanelet_ids.size());
+  }
+  return table;
+}
+
+/**
+ * @brief camera at the origin, 1.5 m high and looking along the map x axis
+ *
+ */
+inline Eigen::Isometry3d makeCameraTransform()
+{
+  Eigen::Matrix3d rotation;
+  // camera z forward is map x, camera x right is map -y, camera y down is map -z
+  rotation << 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, 0.0, -1.0, 0.0;
+  Eigen::Isometry3d tf_map2camera = Eigen::Isometry3d::Identity();
+  tf_map2camera.linear() = rotation;
+  tf_map2camera.translation() << 0.0, 0.0, 1.5;
+  return tf_map2camera;
+}
+
+/**
+ * @brief Poses of a camera driving at 15 m/s through a 0.1 s timestamp window, with some pitch
+ * vibration
+ *
+ * @param sample_num   number of sampled poses, at least 1
+ */
+inline PoseBundle makePoseBundle(const size_t sample_num)
+{
+  const Eigen::Isometry3d exact = makeCameraTransform();
+  std::vector<Eigen::Isometry3d> samples;
+  samples.reserve(sample_num);
+  for (size_t i = 0; i < sample_num; ++i) {
+    const double t = sample_num > 1 ? static_cast<double>(i) / (sample_num - 1) - 0.5 : 0.0;
+    Eigen::Isometry3d sample = exact;
+    sample.translate(Eigen::Vector3d(0.0, 0.0, 1.5 * t));
+    sample.rotate(Eigen::AngleAxisd(0.005 * t, Eigen::Vector3d::UnitX()));
+    samples.push_back(sample);
+  }
+  return traffic_mirror::makePoseBundle(exact, samples);
+}
+
+inline DetectionConfig makeDetectionConfig(const RoughRoiMode rough_roi_mode)
+{
+  DetectionConfig config;
+  config.vibration.max_vibration_pitch = 0.01745329251;
+  config.vibration.max_vibration_yaw = 0.01745329251;
+  config.vibration.max_vibration_height = 0.5;
+  config.vibration.max_vibration_width = 0.5;
+  config.vibration.max_vibration_depth = 0.5;
+  config.max_detection_range = 200.0;
+  config.rough_roi_mode = rough_roi_mode;
+  return config;
+}
+
+/**
+ * @brief Points in front of the camera spread over the image, in the camera frame
+ *
+ */
+inline std::vector<Eigen::Vector3d> makeCameraPoints(const size_t n, const uint32_t seed = 1)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> lateral(-0.9, 0.9);
+  std::uniform_real_distribution<double> depth(5.0, 200.0);
+  std::vector<Eigen::Vector3d> points;
+  points.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const double z = depth(rng);
+    points.emplace_back(lateral(rng) * z, 0.5 * lateral(rng) * z, z);
+  }
+  return points;
+}
+}  // namespace traffic_mirror::synthetic
+
+#endif  // SYNTHETIC_SCENE_HPP_
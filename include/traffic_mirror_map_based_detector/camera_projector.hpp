@@ -0,0 +1,160 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__CAMERA_PROJECTOR_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__CAMERA_PROJECTOR_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief plain copy of the camera_info fields needed to project points
+ *
+ */
+struct CameraIntrinsics
+{
+  uint32_t width{0};
+  uint32_t height{0};
+  uint32_t binning_x{0};
+  uint32_t binning_y{0};
+  /**
+   * @brief roi of the camera_info, zero size means full resolution
+   *
+   */
+  uint32_t roi_x_offset{0};
+  uint32_t roi_y_offset{0};
+  uint32_t roi_width{0};
+  uint32_t roi_height{0};
+  std::string distortion_model;
+  std::vector<double> d;
+  std::array<double, 9> k{};
+  std::array<double, 9> r{};
+  std::array<double, 12> p{};
+};
+
+/**
+ * @brief Projects points in the camera frame to raw (distorted) pixels with the distortion
+ * polynomial evaluated inline. Gives the same result as
+ * image_geometry::PinholeCameraModel::project3dToPixel followed by unrectifyPoint, without the
+ * OpenCV call overhead and allocations per point.
+ *
+ */
+class CameraProjector
+{
+public:
+  CameraProjector() = default;
+  explicit CameraProjector(const CameraIntrinsics & intrinsics);
+
+  /**
+   * @brief false for the camera models the inline evaluator does not cover (unknown distortion
+   * models, binning or roi), which must be projected with image_geometry instead
+   *
+   */
+  bool isSupported() const { return is_supported_; }
+  /**
+   * @brief false if every distortion coefficient is zero, the projection is then a plain pinhole
+   *
+   */
+  bool hasDistortion() const { return has_distortion_; }
+
+  /**
+   * @brief project a point in the camera frame to the raw image
+   *
+   * @param x   point in the camera frame
+   * @param y   point in the camera frame
+   * @param z   point in the camera frame, must be positive
+   * @param u   raw pixel
+   * @param v   raw pixel
+   */
+  void projectToRaw(const double x, const double y, const double z, double & u, double & v) const
+  {
+    // rectified pixel, as project3dToPixel
+    const double u_rect = (p_fx_ * x + p_tx_) / z + p_cx_;
+    const double v_rect = (p_fy_ * y + p_ty_) / z + p_cy_;
+    if (!has_distortion_) {
+      u = u_rect;
+      v = v_rect;
+      return;
+    }
+    // ray of the rectified pixel, as projectPixelTo3dRay
+    const double ray_x = (u_rect - p_cx_ - p_tx_) / p_fx_;
+    const double ray_y = (v_rect - p_cy_ - p_ty_) / p_fy_;
+    // rotate into the unrectified camera frame and distort, as cv::projectPoints. The ray of a
+    // point in front of the camera never ends up at zero depth, so no check is needed
+    const double cam_x = rt_[0] * ray_x + rt_[1] * ray_y + rt_[2];
+    const double cam_y = rt_[3] * ray_x + rt_[4] * ray_y + rt_[5];
+    const double cam_z = rt_[6] * ray_x + rt_[7] * ray_y + rt_[8];
+    const double inv_z = 1.0 / cam_z;
+    const double xn = cam_x * inv_z;
+    const double yn = cam_y * inv_z;
+    const double r2 = xn * xn + yn * yn;
+    const double r4 = r2 * r2;
+    const double r6 = r4 * r2;
+    const double radial = (1.0 + k1_ * r2 + k2_ * r4 + k3_ * r6) /
+                          (1.0 + k4_ * r2 + k5_ * r4 + k6_ * r6);
+    const double xd = xn * radial + 2.0 * p1_ * xn * yn + p2_ * (r2 + 2.0 * xn * xn);
+    const double yd = yn * radial + p1_ * (r2 + 2.0 * yn * yn) + 2.0 * p2_ * xn * yn;
+    u = k_fx_ * xd + k_cx_;
+    v = k_fy_ * yd + k_cy_;
+  }
+
+  /**
+   * @brief project n points in the camera frame to the raw image, as projectToRaw per point. The
+   * arrays must not overlap
+   *
+   * @param xs  points in the camera frame
+   * @param ys  points in the camera frame
+   * @param zs  points in the camera frame
+   * @param n   number of points
+   * @param us  raw pixels
+   * @param vs  raw pixels
+   */
+  void projectToRaw(
+    const double * __restrict xs, const double * __restrict ys, const double * __restrict zs,
+    const size_t n, double * __restrict us, double * __restrict vs) const;
+
+private:
+  bool is_supported_{false};
+  bool has_distortion_{false};
+  // projection matrix P
+  double p_fx_{1.0};
+  double p_fy_{1.0};
+  double p_cx_{0.0};
+  double p_cy_{0.0};
+  double p_tx_{0.0};
+  double p_ty_{0.0};
+  // camera matrix K
+  double k_fx_{1.0};
+  double k_fy_{1.0};
+  double k_cx_{0.0};
+  double k_cy_{0.0};
+  // transposed rectification matrix R, row major
+  std::array<double, 9> rt_{};
+  // distortion coefficients, zero when the model does not have them
+  double k1_{0.0};
+  double k2_{0.0};
+  double p1_{0.0};
+  double p2_{0.0};
+  double k3_{0.0};
+  double k4_{0.0};
+  double k5_{0.0};
+  double k6_{0.0};
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__CAMERA_PROJECTOR_HPP_
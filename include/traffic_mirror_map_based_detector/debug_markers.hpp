@@ -0,0 +1,41 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DEBUG_MARKERS_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DEBUG_MARKERS_HPP_
+
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <std_msgs/msg/header.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Build the beams from the camera to the visible traffic mirrors for visualization
+ *
+ * @param camera_pose               the camera pose
+ * @param cam_info_header           header of the camera_info message
+ * @param traffic_mirrors           traffic mirror table
+ * @param visible_traffic_mirrors   indices of the visible traffic mirrors in the table
+ * @return                          one line list marker per visible traffic mirror
+ */
+visualization_msgs::msg::MarkerArray makeVisibleTrafficMirrorMarkers(
+  const CameraPose & camera_pose, const std_msgs::msg::Header & cam_info_header,
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible_traffic_mirrors);
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DEBUG_MARKERS_HPP_
@@ -0,0 +1,438 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTION_ENGINE_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTION_ENGINE_HPP_
+
+#include "traffic_mirror_map_based_detector/camera_projector.hpp"
+#include "traffic_mirror_map_based_detector/roi_projection_kernel.hpp"
+#include "traffic_mirror_map_based_detector/spatial_grid.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace traffic_mirror
+{
+enum class RoughRoiMode {
+  /**
+   * @brief project the traffic light for every sampled pose and take the union
+   *
+   */
+  Sampling,
+  /**
+   * @brief project the traffic light once, enlarged by the motion bound of the sampled poses.
+   * Only for undistorted and plumb_bob cameras, the other models are sampled
+   *
+   */
+  Analytic,
+};
+
+/**
+ * @brief the parameters of the culling and the roi computation
+ *
+ */
+struct DetectionConfig
+{
+  VibrationBound vibration;
+  double max_detection_range{200.0};
+  /**
+   * @brief largest angle [rad] between the facing of a visible traffic mirror and the camera, 40
+   * degrees by default
+   *
+   */
+  double max_angle_range{0.6981317008};
+  RoughRoiMode rough_roi_mode{RoughRoiMode::Sampling};
+  /**
+   * @brief project the roi corners of all visible traffic mirrors in one batch if the camera
+   * model allows it. Off, they are projected one traffic mirror at a time, as with the fallback
+   * projection; only the tests and the benchmarks compare both paths
+   *
+   */
+  bool batch_projection{true};
+  /**
+   * @brief reject the traffic mirrors outside the view frustum before projecting them. Off, every
+   * candidate is projected; only the tests compare both
+   *
+   */
+  bool view_frustum_culling{true};
+};
+
+/**
+ * @brief bound of the camera motion in the timestamp window, relative to the pose at the exact
+ * moment
+ *
+ */
+struct MotionBound
+{
+  double max_translation{0.0};
+  double max_rotation{0.0};
+};
+
+/**
+ * @brief image size of the camera, precomputed for the clamp and in-frame checks
+ *
+ */
+struct ImageBounds
+{
+  uint32_t width{0};
+  uint32_t height{0};
+  /**
+   * @brief largest pixel coordinates inside the image
+   *
+   */
+  double max_x{0.0};
+  double max_y{0.0};
+};
+
+/**
+ * @brief Conservative view frustum of the camera as four half-planes through the camera origin,
+ * in the camera frame. The planes bound every ray the distorted projection maps into the image,
+ * including the rays a distortion polynomial folds back into it, among the rays within
+ * max_angle of the optical axis in both the x / z and the y / z directions. The rays beyond are
+ * not bounded, so a ball is only rejected if it also lies within max_angle
+ *
+ */
+struct ViewFrustum
+{
+  /**
+   * @brief unit normals of the left, right, top and bottom planes, pointing into the frustum
+   *
+   */
+  std::array<Eigen::Vector3d, 4> inward_normals;
+  /**
+   * @brief unit normals of the planes at max_angle, pointing into the checked range
+   *
+   */
+  std::array<Eigen::Vector3d, 4> range_normals;
+  /**
+   * @brief false if the frustum cannot be derived from the camera, then it contains everything
+   *
+   */
+  bool is_valid{false};
+
+  /**
+   * @brief the rays up to 89 degrees off the optical axis are checked, the projection of a
+   * pinhole camera degenerates at 90 degrees
+   *
+   */
+  static constexpr double max_angle = 89.0 * 3.14159265358979323846 / 180.0;
+
+  /**
+   * @brief false if a ball is entirely outside the frustum
+   *
+   * @param center      center of the ball in the camera frame
+   * @param sq_radius   squared radius of the ball
+   */
+  bool intersects(const Eigen::Vector3d & center, const double sq_radius) const
+  {
+    if (!is_valid) {
+      return true;
+    }
+    for (const auto & normal : inward_normals) {
+      const double distance = normal.dot(center);
+      if (distance < 0.0 && distance * distance > sq_radius) {
+        return !isInCheckedRange(center, sq_radius);
+      }
+    }
+    return true;
+  }
+
+private:
+  /**
+   * @brief true if a ball is entirely within the angles the frustum was checked for
+   *
+   */
+  bool isInCheckedRange(const Eigen::Vector3d & center, const double sq_radius) const
+  {
+    for (const auto & normal : range_normals) {
+      const double distance = normal.dot(center);
+      if (distance <= 0.0 || distance * distance < sq_radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief one camera pose with the values derived from it that every stage needs
+ *
+ */
+struct CameraPose
+{
+  Eigen::Isometry3d tf_map2camera{Eigen::Isometry3d::Identity()};
+  Eigen::Isometry3d tf_camera2map{Eigen::Isometry3d::Identity()};
+  /**
+   * @brief direction of the camera z axis in map
+   *
+   */
+  Eigen::Vector3d forward{Eigen::Vector3d::UnitZ()};
+  /**
+   * @brief unit direction of forward on the xy plane of map, x axis if the camera looks straight
+   * up or down
+   *
+   */
+  Eigen::Vector2d forward_xy{Eigen::Vector2d::UnitX()};
+};
+
+/**
+ * @brief camera poses of one camera_info frame
+ *
+ */
+struct PoseBundle
+{
+  /**
+   * @brief pose at the exact moment
+   *
+   */
+  CameraPose exact;
+  /**
+   * @brief poses sampled in the timestamp window, never empty
+   *
+   */
+  std::vector<CameraPose> samples;
+  MotionBound motion_bound;
+};
+
+/**
+ * @brief Derive the camera pose of a transform from map to the camera frame
+ *
+ * @param tf_map2camera   pose of the camera in map
+ * @return                camera pose
+ */
+CameraPose makeCameraPose(const Eigen::Isometry3d & tf_map2camera);
+
+/**
+ * @brief Derive the camera poses of one frame
+ *
+ * @param tf_map2camera       pose of the camera at the exact moment
+ * @param tf_map2camera_vec   poses sampled in the timestamp window, the exact pose if empty
+ * @return                    camera poses
+ */
+PoseBundle makePoseBundle(
+  const Eigen::Isometry3d & tf_map2camera,
+  const std::vector<Eigen::Isometry3d> & tf_map2camera_vec);
+
+/**
+ * @brief region of interest in the raw image, as sensor_msgs/RegionOfInterest
+ *
+ */
+struct Roi
+{
+  uint32_t x_offset{0};
+  uint32_t y_offset{0};
+  uint32_t width{0};
+  uint32_t height{0};
+};
+
+/**
+ * @brief rois of one visible traffic mirror
+ *
+ */
+struct DetectedRoi
+{
+  int64_t traffic_mirror_id{0};
+  /**
+   * @brief roi enlarged by the vibration and the camera motion in the timestamp window
+   *
+   */
+  Roi rough_roi;
+  /**
+   * @brief roi at the exact moment without enlargement
+   *
+   */
+  Roi expect_roi;
+};
+
+/**
+ * @brief Projection of a point in the camera frame to the raw image, for the camera models
+ * CameraProjector does not cover
+ *
+ */
+using RawProjection = std::function<void(double x, double y, double z, double & u, double & v)>;
+
+/**
+ * @brief Culling and roi computation of the traffic mirrors for one camera, without any ROS
+ * dependency: it takes a traffic mirror table, camera poses and camera intrinsics and returns
+ * rois. The engine keeps the buffers of the batched projection between frames, so one engine
+ * serves one camera at a time
+ *
+ */
+class DetectionEngine
+{
+public:
+  DetectionEngine() : DetectionEngine(DetectionConfig{}) {}
+  explicit DetectionEngine(const DetectionConfig & config);
+
+  /**
+   * @brief Set the camera of the following frames
+   *
+   * @param intrinsics            camera intrinsics
+   * @param fallback_projection   projection used if CameraProjector does not support the camera
+   * model. Without it, nothing is visible for such a camera
+   */
+  void setCamera(const CameraIntrinsics & intrinsics, RawProjection fallback_projection = nullptr);
+
+  /**
+   * @brief true if the camera model is projected inline and in batches
+   *
+   */
+  bool isProjectorSupported() const { return projector_.isSupported(); }
+
+  const DetectionConfig & config() const { return config_; }
+
+  /**
+   * @brief Get the traffic mirrors of the grid close enough to the camera to be visible
+   *
+   * @param grid          grid over the traffic mirror centers of the table
+   * @param poses         the camera poses of the frame
+   * @param candidates    sorted indices of the candidates in the table, appended
+   */
+  void getCandidateTrafficMirrors(
+    const SpatialGrid & grid, const PoseBundle & poses, std::vector<size_t> & candidates) const;
+
+  /**
+   * @brief Get the candidates in range, facing the camera and in the image under any sampled pose
+   *
+   * @param traffic_mirrors   traffic mirror table
+   * @param candidates        sorted indices of the traffic mirrors to check in the table
+   * @param poses             the camera poses of the frame
+   * @param visible           indices of the visible traffic mirrors in the table, appended
+   */
+  void getVisibleTrafficMirrors(
+    const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & candidates,
+    const PoseBundle & poses, std::vector<size_t> & visible) const;
+
+  /**
+   * @brief Compute the rough and expect rois of the visible traffic mirrors
+   *
+   * @param traffic_mirrors   traffic mirror table
+   * @param visible           indices of the visible traffic mirrors in the table
+   * @param poses             the camera poses of the frame
+   * @param rois              rois of the traffic mirrors having both rois, appended
+   */
+  void getTrafficMirrorRois(
+    const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible,
+    const PoseBundle & poses, std::vector<DetectedRoi> & rois);
+
+  /**
+   * @brief The whole frame: candidates, visibility and rois
+   *
+   * @param traffic_mirrors   traffic mirror table
+   * @param grid              grid over the traffic mirror centers of the table
+   * @param poses             the camera poses of the frame
+   * @param rois              rois of the visible traffic mirrors, appended
+   */
+  void detect(
+    const TrafficMirrorTable & traffic_mirrors, const SpatialGrid & grid, const PoseBundle & poses,
+    std::vector<DetectedRoi> & rois);
+
+private:
+  bool useAnalyticRoughRoi() const
+  {
+    return config_.rough_roi_mode == RoughRoiMode::Analytic && has_analytic_bound_;
+  }
+  bool projectToRaw(const Eigen::Vector3d & point, double & u, double & v) const;
+  bool isInImageFrame(const Eigen::Vector3d & point) const;
+  /**
+   * @brief Build the view frustum of the current camera: the bounds of the rays of a grid over
+   * the supported angles that project into the image, enlarged by one grid step
+   *
+   */
+  ViewFrustum makeViewFrustum(const CameraIntrinsics & intrinsics) const;
+  /**
+   * @brief roi between the raw pixels of the enlarged corners, clamped to the image
+   *
+   * @return false  the roi is smaller than a pixel, or its corners are swapped
+   */
+  bool makeRoi(
+    double top_left_u, double top_left_v, double bottom_right_u, double bottom_right_v,
+    Roi & roi) const;
+  /**
+   * @brief roi of one traffic mirror under one pose, enlarged by the vibration
+   *
+   */
+  bool getTrafficMirrorRoi(
+    const CameraPose & camera_pose, const TrafficMirrorTable & traffic_mirrors,
+    const size_t traffic_mirror, const VibrationBound & vibration, Roi & roi) const;
+  /**
+   * @brief union of the rois of one traffic mirror under every pose
+   *
+   */
+  bool getTrafficMirrorRoi(
+    const std::vector<CameraPose> & camera_poses, const TrafficMirrorTable & traffic_mirrors,
+    const size_t traffic_mirror, const VibrationBound & vibration, Roi & roi) const;
+  /**
+   * @brief outermost raw pixel of a traffic mirror corner under every pose of the timestamp
+   * window, enlarged by the vibration
+   *
+   * @param sign  -1 for the top left corner, bounded from the top left, 1 for the bottom right
+   */
+  bool projectCornerBound(
+    const Eigen::Vector3d & camera2corner, const MotionBound & motion_bound,
+    const VibrationBound & vibration, const double sign, double & u, double & v) const;
+  /**
+   * @brief roi of one traffic mirror under one pose, enlarged by the vibration and the motion
+   * bound of the timestamp window
+   *
+   */
+  bool getTrafficMirrorRoi(
+    const CameraPose & camera_pose, const MotionBound & motion_bound,
+    const TrafficMirrorTable & traffic_mirrors, const size_t traffic_mirror,
+    const VibrationBound & vibration, Roi & roi) const;
+  /**
+   * @brief getTrafficMirrorRois with the batched projection
+   *
+   */
+  void getTrafficMirrorRoisBatch(
+    const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible,
+    const PoseBundle & poses, std::vector<DetectedRoi> & rois);
+
+  DetectionConfig config_;
+  /**
+   * @brief a traffic mirror faces the camera if the dot product of their directions is above it
+   *
+   */
+  double cos_max_angle_range_{0.0};
+  CameraProjector projector_;
+  RawProjection fallback_projection_;
+  ImageBounds image_bounds_;
+  ViewFrustum view_frustum_;
+  /**
+   * @brief the camera model allows the analytic rough roi, otherwise it is sampled whatever the
+   * rough_roi_mode
+   *
+   */
+  bool has_analytic_bound_{false};
+  /**
+   * @brief batched roi projection of the visible traffic mirrors, and its buffers
+   *
+   */
+  RoiProjectionKernel roi_kernel_;
+  RoiCorners roi_corners_;
+  std::vector<DetectedRoi> detected_rois_;
+  std::vector<uint8_t> has_expect_roi_;
+  std::vector<uint8_t> has_rough_roi_;
+  std::vector<size_t> candidates_;
+  std::vector<size_t> visible_;
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTION_ENGINE_HPP_
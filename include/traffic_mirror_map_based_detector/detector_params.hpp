@@ -0,0 +1,49 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTOR_PARAMS_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTOR_PARAMS_HPP_
+
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+
+#include <rclcpp/node.hpp>
+
+namespace traffic_mirror
+{
+/**
+ * @brief the parameters of the culling, the roi computation and the pose sampling, read the same
+ * way by the node and the replay
+ *
+ */
+struct DetectorParams
+{
+  DetectionConfig detection;
+  /**
+   * @brief default timestamp window of the cameras and how the poses in it are sampled
+   *
+   */
+  TimestampSampling sampling;
+};
+
+/**
+ * @brief Declare the detector parameters on a node and validate them. An invalid value is logged
+ * and replaced by its default
+ *
+ * @param node   node to declare the parameters on
+ * @return       the validated parameters
+ */
+DetectorParams declareDetectorParams(rclcpp::Node & node);
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__DETECTOR_PARAMS_HPP_
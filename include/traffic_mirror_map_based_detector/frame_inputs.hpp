@@ -0,0 +1,98 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__FRAME_INPUTS_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__FRAME_INPUTS_HPP_
+
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+
+#include <image_geometry/pinhole_camera_model.h>
+#include <rclcpp/time.hpp>
+#include <tf2/LinearMath/Transform.h>
+
+#include <sensor_msgs/msg/camera_info.hpp>
+
+#include <Eigen/Geometry>
+
+#include <functional>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief the timestamp window of a camera and how the poses in it are sampled
+ *
+ */
+struct TimestampSampling
+{
+  double min_timestamp_offset{0.0};
+  double max_timestamp_offset{0.0};
+  double timestamp_sample_len{0.01};
+  bool adaptive_sampling{false};
+  double adaptive_sampling_max_angle_step{0.001};
+  double adaptive_sampling_max_translation_step{0.1};
+};
+
+/**
+ * @brief Look up the transform from map to the camera at a time
+ *
+ */
+using TransformLookup = std::function<bool(const rclcpp::Time & t, tf2::Transform & tf)>;
+
+/**
+ * @brief Sample the transforms from map to the camera in the timestamp window. Only the ends of
+ * the window are looked up, the samples in between are interpolated from them and the pose at
+ * the exact moment. In the adaptive mode the sample count follows the camera motion in the window
+ *
+ * @param sampling            timestamp window of the camera
+ * @param stamp               timestamp of the camera_info message
+ * @param tf_map2camera       the transformation from map to camera at the exact moment
+ * @param lookup              lookup of the transforms of the window ends
+ * @param tf_map2camera_vec   sampled transforms, appended
+ */
+void sampleTransforms(
+  const TimestampSampling & sampling, const rclcpp::Time & stamp,
+  const tf2::Transform & tf_map2camera, const TransformLookup & lookup,
+  std::vector<tf2::Transform> & tf_map2camera_vec);
+
+Eigen::Isometry3d toIsometry(const tf2::Transform & tf);
+
+/**
+ * @brief Derive the camera poses of one frame from the sampled transforms
+ *
+ * @param tf_map2camera       pose of the camera at the exact moment
+ * @param tf_map2camera_vec   poses sampled in the timestamp window
+ * @return                    camera poses
+ */
+PoseBundle makePoseBundle(
+  const tf2::Transform & tf_map2camera, const std::vector<tf2::Transform> & tf_map2camera_vec);
+
+CameraIntrinsics makeCameraIntrinsics(const sensor_msgs::msg::CameraInfo & camera_info);
+
+/**
+ * @brief true if the camera model of both messages is the same
+ *
+ */
+bool hasSameIntrinsics(
+  const sensor_msgs::msg::CameraInfo & info1, const sensor_msgs::msg::CameraInfo & info2);
+
+/**
+ * @brief Projection of image_geometry for the camera models CameraProjector does not cover
+ *
+ * @param pinhole_camera_model   camera model, must outlive the projection
+ * @return                       project3dToPixel followed by unrectifyPoint
+ */
+RawProjection makeRawProjection(const image_geometry::PinholeCameraModel & pinhole_camera_model);
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__FRAME_INPUTS_HPP_
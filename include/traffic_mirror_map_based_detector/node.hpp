@@ -20,25 +20,42 @@
 
 #include <autoware_auto_mapping_msgs/msg/had_map_bin.hpp>
 #include <autoware_planning_msgs/msg/lanelet_route.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include <geometry_msgs/msg/pose_stamped.hpp>
 #include <sensor_msgs/msg/camera_info.hpp>
 #include <tier4_perception_msgs/msg/traffic_light_roi_array.hpp>
 #include <visualization_msgs/msg/marker_array.hpp>
 
 #include "tier4_perception_msgs/msg/traffic_mirror_roi_array.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/detector_params.hpp"
+#include "traffic_mirror_map_based_detector/route_horizon.hpp"
+#include "traffic_mirror_map_based_detector/spatial_grid.hpp"
+#include "traffic_mirror_map_based_detector/stage_metrics.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_cache.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
 
 #include <image_geometry/pinhole_camera_model.h>
 #include <lanelet2_core/LaneletMap.h>
 #include <lanelet2_routing/RoutingGraph.h>
 #include <lanelet2_traffic_rules/TrafficRulesFactory.h>
+#include <tf2/LinearMath/Transform.h>
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_listener.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace traffic_mirror
@@ -47,70 +64,242 @@ class MapBasedDetector : public rclcpp::Node
 {
 public:
   explicit MapBasedDetector(const rclcpp::NodeOptions & node_options);
+  ~MapBasedDetector() override;
 
 private:
   struct Config
   {
-    double max_vibration_pitch;
-    double max_vibration_yaw;
-    double max_vibration_height;
-    double max_vibration_width;
-    double max_vibration_depth;
-    double min_timestamp_offset;
-    double max_timestamp_offset;
-    double timestamp_sample_len;
-    double max_detection_range;
+    /**
+     * @brief the parameters shared with the replay, see declareDetectorParams
+     *
+     */
+    DetectionConfig detection;
+    TimestampSampling sampling;
+    bool use_nonblocking_tf;
+    int max_pending_frames;
+    double pending_frame_timeout;
+    std::string traffic_mirror_cache_dir;
+    bool route_horizon_mode;
+    double route_horizon_ahead;
+    double route_horizon_behind;
+    bool skip_unknown_route_primitives;
+    double metrics_publish_period;
   };
 
-  struct IdLessThan
+  /**
+   * @brief everything that belongs to one camera: its topics, timestamp window, deferred frames
+   * and camera model. The map, the route and the tf buffer are shared by all the cameras
+   *
+   */
+  struct CameraContext
   {
-    bool operator()(
-      const lanelet::ConstLineString3d & left, const lanelet::ConstLineString3d & right) const
-    {
-      return left.id() < right.id();
-    }
+    /**
+     * @brief name of the camera, empty in the single camera mode
+     *
+     */
+    std::string name;
+    double min_timestamp_offset;
+    double max_timestamp_offset;
+    /**
+     * @brief mutually exclusive group of the camera callbacks. The frames of one camera are
+     * processed in order, the cameras run in parallel on a multi-threaded executor
+     *
+     */
+    rclcpp::CallbackGroup::SharedPtr callback_group;
+    rclcpp::Subscription<sensor_msgs::msg::CameraInfo>::SharedPtr camera_info_sub;
+    rclcpp::TimerBase::SharedPtr pending_timer;
+    /**
+     * @brief publish the rois of traffic lights with angular and distance offset
+     *
+     */
+    rclcpp::Publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>::SharedPtr roi_pub;
+    /**
+     * @brief publish the rois of traffic lights with zero angular and distance offset
+     *
+     */
+    rclcpp::Publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>::SharedPtr
+      expect_roi_pub;
+    rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr viz_pub;
+    /**
+     * @brief camera_info frames waiting for their tf in the non-blocking mode, oldest first
+     *
+     */
+    std::deque<sensor_msgs::msg::CameraInfo::ConstSharedPtr> pending_camera_infos;
+    uint64_t deferred_frame_count{0};
+    uint64_t dropped_frame_count{0};
+    /**
+     * @brief camera model of the latest camera_info, rebuilt only when the intrinsics change. The
+     * engine falls back to it for the camera models it does not project inline
+     *
+     */
+    image_geometry::PinholeCameraModel pinhole_camera_model;
+    uint64_t camera_model_rebuild_count{0};
+    /**
+     * @brief culling and roi computation of the camera
+     *
+     */
+    DetectionEngine engine;
+    /**
+     * @brief window of the route horizon around the camera, in the route horizon mode
+     *
+     */
+    RouteHorizonTracker route_horizon_tracker;
+    /**
+     * @brief latencies of the callback stages, published and reset every metrics_publish_period
+     *
+     */
+    StageMetrics metrics;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr metrics_pub;
+    rclcpp::TimerBase::SharedPtr metrics_timer;
   };
 
 private:
   rclcpp::Subscription<autoware_auto_mapping_msgs::msg::HADMapBin>::SharedPtr map_sub_;
-  rclcpp::Subscription<sensor_msgs::msg::CameraInfo>::SharedPtr camera_info_sub_;
   rclcpp::Subscription<autoware_planning_msgs::msg::LaneletRoute>::SharedPtr route_sub_;
   /**
-   * @brief publish the rois of traffic lights with angular and distance offset
+   * @brief reentrant group of the map and route callbacks, they only hand over to the map worker
    *
    */
-  rclcpp::Publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>::SharedPtr roi_pub_;
+  rclcpp::CallbackGroup::SharedPtr map_callback_group_;
   /**
-   * @brief publish the rois of traffic lights with zero angular and distance offset
+   * @brief the cameras served by the node, the callbacks hold pointers to them
    *
    */
-  rclcpp::Publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>::SharedPtr expect_roi_pub_;
-  rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr viz_pub_;
+  std::vector<std::unique_ptr<CameraContext>> cameras_;
 
   tf2_ros::Buffer tf_buffer_;
   tf2_ros::TransformListener tf_listener_;
 
-  using TrafficMirrorSet = std::set<lanelet::ConstLineString3d, IdLessThan>;
+  /**
+   * @brief traffic mirrors ordered by id, and a grid over their centers for range queries
+   *
+   */
+  struct TrafficMirrorIndex
+  {
+    TrafficMirrorTable table;
+    SpatialGrid grid;
+    /**
+     * @brief indices in the table of the traffic mirrors each lanelet refers to
+     *
+     */
+    std::unordered_map<lanelet::Id, std::vector<size_t>> lanelet_traffic_mirrors;
+  };
 
-  std::shared_ptr<TrafficMirrorSet> all_traffic_mirrors_ptr_;
-  std::shared_ptr<TrafficMirrorSet> route_traffic_mirrors_ptr_;
+  /**
+   * @brief the current route as seen by the map worker, so that a new route only applies its
+   * difference to the previous one
+   *
+   */
+  struct RouteState
+  {
+    std::unordered_set<lanelet::Id> lanelet_ids;
+    /**
+     * @brief number of route lanelets referring to each traffic mirror on the route, by index in
+     * the table of all the traffic mirrors
+     *
+     */
+    std::unordered_map<size_t, size_t> traffic_mirror_ref_counts;
+  };
+
+  /**
+   * @brief everything derived from the map and the route. A snapshot is never modified once
+   * published, the map worker publishes a new one with std::atomic_store and the callbacks take
+   * one per frame with std::atomic_load
+   *
+   */
+  struct DetectorState
+  {
+    lanelet::LaneletMapConstPtr lanelet_map;
+    std::shared_ptr<const TrafficMirrorIndex> all_traffic_mirrors;
+    std::shared_ptr<const TrafficMirrorIndex> route_traffic_mirrors;
+    /**
+     * @brief traffic mirrors of route_traffic_mirrors along the route, in the route horizon mode
+     *
+     */
+    std::shared_ptr<const RouteHorizon> route_horizon;
+    /**
+     * @brief number of primitives of the last route missing in the map, they are skipped in the
+     * skip_unknown_route_primitives mode
+     *
+     */
+    size_t missing_route_primitive_num{0};
+  };
+
+  /**
+   * @brief latest snapshot, only accessed through std::atomic_load / std::atomic_store
+   *
+   */
+  std::shared_ptr<const DetectorState> state_;
+
+  /**
+   * @brief the map and route messages are decoded on the map worker thread so that the camera
+   * callbacks never wait for them. Only the latest unprocessed message of each is kept
+   *
+   */
+  std::thread map_worker_;
+  std::mutex map_worker_mutex_;
+  std::condition_variable map_worker_cv_;
+  autoware_auto_mapping_msgs::msg::HADMapBin::ConstSharedPtr pending_map_msg_;
+  autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr pending_route_msg_;
+  bool stop_map_worker_{false};
+  /**
+   * @brief route of the current route index, only used on the map worker thread
+   *
+   */
+  RouteState route_state_;
 
-  lanelet::LaneletMapPtr lanelet_map_ptr_;
   lanelet::traffic_rules::TrafficRulesPtr traffic_rules_ptr_;
   lanelet::routing::RoutingGraphPtr routing_graph_ptr_;
 
   Config config_;
+  /**
+   * @brief Add a camera with its own camera_info subscription and roi publishers
+   *
+   * @param name                    name of the camera, empty for the original topic names
+   * @param min_timestamp_offset    start of the timestamp window of the camera
+   * @param max_timestamp_offset    end of the timestamp window of the camera
+   */
+  void addCamera(
+    const std::string & name, const double min_timestamp_offset,
+    const double max_timestamp_offset);
   /**
    * @brief Calculated the transform from map to frame_id at timestamp t
    *
    * @param t           specified timestamp
    * @param frame_id    specified target frame id
+   * @param timeout     how long to wait for the transform
    * @param tf          calculated transform
    * @return true       calculation succeed
    * @return false      calculation failed
    */
   bool getTransform(
-    const rclcpp::Time & t, const std::string & frame_id, tf2::Transform & tf) const;
+    const rclcpp::Time & t, const std::string & frame_id, const rclcpp::Duration & timeout,
+    tf2::Transform & tf) const;
+  /**
+   * @brief Sample the transforms from map to the camera in the timestamp window. Only the ends of
+   * the window are looked up, the samples in between are interpolated from them and the pose at
+   * the exact moment. In the adaptive mode the sample count follows the camera motion in the window
+   *
+   * @param camera              camera of the message, gives the timestamp window
+   * @param header              header of the camera_info message
+   * @param tf_map2camera       the transformation from map to camera at the exact moment
+   * @param timeout             how long to wait for the transforms of the window ends
+   * @param tf_map2camera_vec   sampled transforms, appended
+   */
+  void sampleTransforms(
+    const CameraContext & camera, const std_msgs::msg::Header & header,
+    const tf2::Transform & tf_map2camera, const rclcpp::Duration & timeout,
+    std::vector<tf2::Transform> & tf_map2camera_vec) const;
+  /**
+   * @brief Check without waiting whether all the transforms needed for a camera_info are available
+   *
+   * @param camera        camera of the message
+   * @param camera_info   camera_info message
+   * @return true         the transforms are available
+   * @return false        the transforms are not available yet
+   */
+  bool isTransformReady(
+    const CameraContext & camera, const sensor_msgs::msg::CameraInfo & camera_info) const;
   /**
    * @brief callback function for the map message
    *
@@ -118,11 +307,29 @@ private:
    */
   void mapCallback(const autoware_auto_mapping_msgs::msg::HADMapBin::ConstSharedPtr input_msg);
   /**
-   * @brief callback function for the camera info message. The main process function of the node
+   * @brief callback function for the camera info message. In the non-blocking mode the frame is
+   * deferred if its tf is not available yet
+   *
+   * @param input_msg
+   * @param camera      camera the message belongs to
+   */
+  void cameraInfoCallback(
+    const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg, CameraContext & camera);
+  /**
+   * @brief process the deferred camera_info frames of the camera whose tf has arrived, and drop
+   * the expired ones
+   *
+   * @param camera
+   */
+  void processPendingCameraInfos(CameraContext & camera);
+  /**
+   * @brief The main process function of the node
    *
    * @param input_msg
+   * @param camera      camera the message belongs to
    */
-  void cameraInfoCallback(const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg);
+  void processCameraInfo(
+    const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg, CameraContext & camera);
   /**
    * @brief callback function for the route message
    *
@@ -130,62 +337,76 @@ private:
    */
   void routeCallback(const autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr input_msg);
   /**
-   * @brief Get the Visible Traffic Lights object
-   *
-   * @param all_traffic_mirrors      all the traffic lights in the route or in the map
-   * @param tf_map2camera_vec           the transformation sequences from map to camera
-   * @param pinhole_camera_model    pinhole model calculated from camera_info
-   * @param visible_traffic_mirrors  the visible traffic lights object
-   */
-  void getVisibleTrafficMirrors(
-    const TrafficMirrorSet & all_traffic_mirrors,
-    const std::vector<tf2::Transform> & tf_map2camera_vec,
-    const image_geometry::PinholeCameraModel & pinhole_camera_model,
-    std::vector<lanelet::ConstLineString3d> & visible_traffic_mirrors) const;
-  /**
-   * @brief Get the Traffic Light Roi from one tf
-   *
-   * @param tf_map2camera         the transformation from map to camera
-   * @param pinhole_camera_model  pinhole model calculated from camera_info
-   * @param traffic_mirror         lanelet traffic light object
-   * @param config                offset configuration
-   * @param roi                   computed result result
-   * @return true                 the computation succeed
-   * @return false                the computation failed
-   */
-  bool getTrafficMirrorRoi(
-    const tf2::Transform & tf_map2camera,
-    const image_geometry::PinholeCameraModel & pinhole_camera_model,
-    const lanelet::ConstLineString3d traffic_mirror, const Config & config,
-    tier4_perception_msgs::msg::TrafficMirrorRoi & roi) const;
-  /**
-   * @brief Calculate one traffic light roi for every tf and return the roi containing all of them
-   *
-   * @param tf_map2camera_vec     the transformation vector
-   * @param pinhole_camera_model  pinhole model calculated from camera_info
-   * @param traffic_mirror         lanelet traffic light object
-   * @param config                offset configuration
-   * @param roi                   computed result result
-   * @return true                 the computation succeed
-   * @return false                the computation failed
-   */
-  bool getTrafficMirrorRoi(
-    const std::vector<tf2::Transform> & tf_map2camera_vec,
-    const image_geometry::PinholeCameraModel & pinhole_camera_model,
-    const lanelet::ConstLineString3d traffic_mirror, const Config & config,
-    tier4_perception_msgs::msg::TrafficMirrorRoi & roi) const;
+   * @brief Loop of the map worker thread: decode the latest map and route messages, and replace
+   * the traffic mirror indices once they are ready
+   *
+   */
+  void runMapWorker();
+  /**
+   * @brief Decode the map
+   *
+   * @param map_msg   map message
+   * @return          decoded map
+   */
+  lanelet::LaneletMapConstPtr loadMap(
+    const autoware_auto_mapping_msgs::msg::HADMapBin & map_msg) const;
+  /**
+   * @brief Index the traffic mirrors of the route lanelets. Only the lanelets added to or removed
+   * from route_state_ are looked up, route_state_ is updated to the new route
+   *
+   * @param state                   snapshot with the map and the index of all the traffic mirrors
+   * @param route_msg               route message
+   * @param missing_primitive_num   number of route primitives missing in the map
+   * @return                        index of the traffic mirrors on the route, nullptr if it
+   * cannot be built
+   */
+  std::shared_ptr<TrafficMirrorIndex> updateRouteTrafficMirrorIndex(
+    const DetectorState & state, const autoware_planning_msgs::msg::LaneletRoute & route_msg,
+    size_t & missing_primitive_num);
+  /**
+   * @brief Order the traffic mirrors of the route index along the route
+   *
+   * @param state       snapshot with the map and the route index
+   * @param route_msg   route message
+   * @return            route horizon, nullptr if it cannot be built
+   */
+  std::shared_ptr<const RouteHorizon> buildRouteHorizon(
+    const DetectorState & state, const autoware_planning_msgs::msg::LaneletRoute & route_msg) const;
+  /**
+   * @brief Build the traffic mirror index from the traffic mirror regulatory elements of lanelets
+   *
+   * @param lanelets   lanelets
+   * @return           index of all the traffic mirrors referenced by the lanelets
+   */
+  std::shared_ptr<TrafficMirrorIndex> buildTrafficMirrorIndex(
+    const lanelet::ConstLanelets & lanelets) const;
+  /**
+   * @brief Build the traffic mirror index of a traffic mirror table
+   *
+   * @param table   traffic mirror table
+   * @return        index owning the table
+   */
+  std::shared_ptr<TrafficMirrorIndex> makeTrafficMirrorIndex(TrafficMirrorTable table) const;
   /**
    * @brief Publish the traffic lights for visualization
    *
-   * @param tf_map2camera           the transformation from map to camera
+   * @param camera_pose             the camera pose
    * @param cam_info_header         header of the camera_info message
-   * @param visible_traffic_mirrors  the visible traffic light object vector
+   * @param traffic_mirrors         traffic light table
+   * @param visible_traffic_mirrors  indices of the visible traffic lights in the table
    * @param pub                     publisher
    */
   void publishVisibleTrafficMirrors(
-    const tf2::Transform & tf_map2camera, const std_msgs::msg::Header & cam_info_header,
-    const std::vector<lanelet::ConstLineString3d> & visible_traffic_mirrors,
+    const CameraPose & camera_pose, const std_msgs::msg::Header & cam_info_header,
+    const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible_traffic_mirrors,
     const rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr pub);
+  /**
+   * @brief Publish the frame counters of a camera, and with the stage metrics compiled in, its
+   * stage metrics since the last call, which are reset
+   *
+   * @param camera  camera whose metrics are published
+   */
+  void publishMetrics(CameraContext & camera);
 };
 }  // namespace traffic_mirror
 #endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__NODE_HPP_
@@ -0,0 +1,124 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROI_PROJECTION_KERNEL_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROI_PROJECTION_KERNEL_HPP_
+
+#include "traffic_mirror_map_based_detector/camera_projector.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief rigid transform p' = rotation * p + translation, rotation row major
+ *
+ */
+struct RigidTransform
+{
+  std::array<double, 9> rotation{1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  std::array<double, 3> translation{0.0, 0.0, 0.0};
+};
+
+/**
+ * @brief maximum calibration and vibration errors the roi is enlarged by
+ *
+ */
+struct VibrationBound
+{
+  double max_vibration_pitch{0.0};
+  double max_vibration_yaw{0.0};
+  double max_vibration_height{0.0};
+  double max_vibration_width{0.0};
+  double max_vibration_depth{0.0};
+};
+
+/**
+ * @brief raw pixels of the enlarged roi corners of every traffic mirror in a batch
+ *
+ */
+struct RoiCorners
+{
+  std::vector<double> top_left_u;
+  std::vector<double> top_left_v;
+  std::vector<double> bottom_right_u;
+  std::vector<double> bottom_right_v;
+  /**
+   * @brief 0 if an enlarged corner is not in front of the camera
+   *
+   */
+  std::vector<uint8_t> is_valid;
+};
+
+/**
+ * @brief Projects the roi corners of many traffic mirrors at once. The corners are gathered into
+ * contiguous arrays and every step is a branch-free `omp simd` loop over them, which the compiler
+ * turns into SIMD code for the target (SSE/AVX/NEON) at -O2 as well as -O3, given -fopenmp-simd,
+ * and plain scalar code elsewhere. The arithmetic is the same as the per-mirror path, so the
+ * results match it.
+ *
+ */
+class RoiProjectionKernel
+{
+public:
+  /**
+   * @brief Set the traffic mirrors of the batch
+   *
+   * @param traffic_mirrors   traffic mirror table
+   * @param indices           indices of the traffic mirrors of the batch in the table
+   */
+  void setTrafficMirrors(
+    const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & indices);
+
+  size_t size() const { return top_left_x_.size(); }
+
+  /**
+   * @brief Project the enlarged roi corners of all the traffic mirrors of the batch
+   *
+   * @param tf_camera2map   transform from map to the camera frame
+   * @param vibration       enlargement of the roi
+   * @param projector       camera projection, must be supported
+   * @param corners         projected corners, resized to the batch
+   */
+  void project(
+    const RigidTransform & tf_camera2map, const VibrationBound & vibration,
+    const CameraProjector & projector, RoiCorners & corners);
+
+private:
+  /**
+   * @brief transform the corners into the camera frame and enlarge them
+   *
+   * @param sign   -1 for the top left corner, 1 for the bottom right one
+   */
+  void transformAndEnlarge(
+    const std::vector<double> & xs, const std::vector<double> & ys, const std::vector<double> & zs,
+    const RigidTransform & tf_camera2map, const VibrationBound & vibration, const double sign);
+
+  std::vector<double> top_left_x_;
+  std::vector<double> top_left_y_;
+  std::vector<double> top_left_z_;
+  std::vector<double> bottom_right_x_;
+  std::vector<double> bottom_right_y_;
+  std::vector<double> bottom_right_z_;
+  // scratch buffers of one corner in the camera frame
+  std::vector<double> camera_x_;
+  std::vector<double> camera_y_;
+  std::vector<double> camera_z_;
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROI_PROJECTION_KERNEL_HPP_
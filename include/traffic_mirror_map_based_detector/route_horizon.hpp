@@ -0,0 +1,124 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROUTE_HORIZON_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROUTE_HORIZON_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief The traffic mirrors of a route ordered by their arc length along it. The route is given
+ * as the centerline of one lanelet per route segment, and the arc length runs over all of them
+ *
+ */
+class RouteHorizon
+{
+public:
+  using Polyline = std::vector<std::pair<double, double>>;
+
+  RouteHorizon() = default;
+  /**
+   * @brief Build the horizon
+   *
+   * @param centerlines               centerline of every route segment, in route order
+   * @param segment_traffic_mirrors   indices of the traffic mirrors each segment refers to
+   * @param center_x                  x of the traffic mirror centers, by index
+   * @param center_y                  y of the traffic mirror centers, by index
+   */
+  RouteHorizon(
+    const std::vector<Polyline> & centerlines,
+    const std::vector<std::vector<size_t>> & segment_traffic_mirrors,
+    const std::vector<double> & center_x, const std::vector<double> & center_y);
+
+  /**
+   * @brief Arc length of the point projected on the closest centerline
+   *
+   * @param x         point
+   * @param y         point
+   * @param hint      arc length of the previous call, only the centerline around it is searched
+   * @param has_hint  false to search the whole route
+   * @return          arc length of the point, 0 for an empty route
+   */
+  double locate(const double x, const double y, const double hint, const bool has_hint) const;
+
+  /**
+   * @brief number of traffic mirror entries, a traffic mirror referred by several segments has one
+   * entry for each
+   *
+   */
+  size_t size() const { return entry_s_.size(); }
+  double entryArcLength(const size_t entry) const { return entry_s_[entry]; }
+  size_t entryTrafficMirror(const size_t entry) const { return entry_traffic_mirrors_[entry]; }
+
+private:
+  /**
+   * @brief closest point of the edges [first_point, last_point) to (x, y)
+   *
+   * @return  squared distance and arc length of the closest point
+   */
+  std::pair<double, double> findClosest(
+    const double x, const double y, const size_t first_point, const size_t last_point) const;
+
+  // centerline points of all the segments, concatenated
+  std::vector<double> point_x_;
+  std::vector<double> point_y_;
+  std::vector<double> point_s_;
+  /**
+   * @brief 1 if the edge from point i to point i + 1 is on a centerline, 0 between two segments
+   *
+   */
+  std::vector<uint8_t> has_edge_;
+  // traffic mirror entries sorted by arc length
+  std::vector<double> entry_s_;
+  std::vector<size_t> entry_traffic_mirrors_;
+};
+
+/**
+ * @brief Sliding window over a route horizon following one camera. The window is moved from its
+ * previous position every frame, so the work per frame does not grow with the route length
+ *
+ */
+class RouteHorizonTracker
+{
+public:
+  /**
+   * @brief Move the window to the camera position and collect its traffic mirrors
+   *
+   * @param horizon           route horizon, the tracker starts over when it changes
+   * @param x                 camera position
+   * @param y                 camera position
+   * @param ahead             length of the window ahead of the camera
+   * @param behind            length of the window behind the camera
+   * @param traffic_mirrors   sorted indices of the traffic mirrors in the window, appended
+   */
+  void update(
+    const std::shared_ptr<const RouteHorizon> & horizon, const double x, const double y,
+    const double ahead, const double behind, std::vector<size_t> & traffic_mirrors);
+
+private:
+  std::shared_ptr<const RouteHorizon> horizon_;
+  bool has_arc_length_{false};
+  double arc_length_{0.0};
+  // entries [begin_, end_) of the horizon are in the window
+  size_t begin_{0};
+  size_t end_{0};
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__ROUTE_HORIZON_HPP_
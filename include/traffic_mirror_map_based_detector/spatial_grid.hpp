@@ -0,0 +1,72 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SPATIAL_GRID_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SPATIAL_GRID_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Uniform 2D grid over a fixed set of points. Points are bucketed by cell once and stored
+ * contiguously per cell, so a box query only touches the cells overlapping the box.
+ *
+ */
+class SpatialGrid
+{
+public:
+  SpatialGrid() = default;
+  /**
+   * @brief Build the grid
+   *
+   * @param xs          x coordinates of the points
+   * @param ys          y coordinates of the points, same size as xs
+   * @param cell_size   edge length of one cell. It is enlarged if the grid would get too many cells
+   */
+  SpatialGrid(const std::vector<double> & xs, const std::vector<double> & ys, double cell_size);
+  /**
+   * @brief Collect the points in the cells overlapping the box. The result is a superset of the
+   * points inside the box, every point is reported at most once.
+   *
+   * @param min_x     box lower x
+   * @param min_y     box lower y
+   * @param max_x     box upper x
+   * @param max_y     box upper y
+   * @param indices   indices of the points, appended
+   */
+  void query(
+    const double min_x, const double min_y, const double max_x, const double max_y,
+    std::vector<size_t> & indices) const;
+
+  size_t size() const { return items_.size(); }
+
+private:
+  size_t cellIndex(const size_t col, const size_t row) const { return row * cols_ + col; }
+
+  double origin_x_{0.0};
+  double origin_y_{0.0};
+  double cell_size_{1.0};
+  size_t cols_{0};
+  size_t rows_{0};
+  /**
+   * @brief items_[cell_offsets_[c] .. cell_offsets_[c + 1]) are the points of cell c
+   *
+   */
+  std::vector<size_t> cell_offsets_;
+  std::vector<size_t> items_;
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SPATIAL_GRID_HPP_
@@ -0,0 +1,147 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__STAGE_METRICS_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__STAGE_METRICS_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Histogram of non-negative integers with a bounded relative error, in the manner of
+ * HdrHistogram: every power of two range is split into the same number of linear buckets, so
+ * recording and the memory are constant whatever the values
+ *
+ */
+class LatencyHistogram
+{
+public:
+  /**
+   * @brief Add one value. Values above max_trackable_value are counted as max_trackable_value
+   *
+   * @param value   value to add, nanoseconds for the stage latencies
+   */
+  void record(const uint64_t value)
+  {
+    const uint64_t clamped = value < max_trackable_value ? value : max_trackable_value;
+    ++counts_[bucketIndex(clamped)];
+    ++total_count_;
+    max_ = clamped > max_ ? clamped : max_;
+  }
+
+  /**
+   * @brief Value below which the given ratio of the recorded values fall
+   *
+   * @param ratio   0.5 for the median, 0.99 for p99
+   * @return        highest value of the bucket of the percentile, within a relative error of
+   * 1 / sub_bucket_half_count. 0 if nothing is recorded
+   */
+  uint64_t percentile(const double ratio) const;
+
+  uint64_t max() const { return max_; }
+  uint64_t count() const { return total_count_; }
+  void reset();
+
+  static constexpr uint64_t max_trackable_value = (uint64_t{1} << 40) - 1;
+
+private:
+  static constexpr int sub_bucket_bits = 5;
+  static constexpr uint64_t sub_bucket_half_count = uint64_t{1} << sub_bucket_bits;
+  // values below 2 * sub_bucket_half_count have a bucket each, then sub_bucket_half_count
+  // buckets per power of two up to max_trackable_value
+  static constexpr size_t bucket_num = (40 - sub_bucket_bits - 1) * sub_bucket_half_count +
+                                       2 * sub_bucket_half_count;
+
+  static size_t bucketIndex(const uint64_t value)
+  {
+    const int msb = value == 0 ? 0 : 63 - __builtin_clzll(value);
+    const int shift = msb > sub_bucket_bits ? msb - sub_bucket_bits : 0;
+    return static_cast<size_t>(shift) * sub_bucket_half_count + (value >> shift);
+  }
+  /**
+   * @brief highest value of a bucket
+   *
+   */
+  static uint64_t bucketUpperValue(const size_t bucket);
+
+  std::array<uint64_t, bucket_num> counts_{};
+  uint64_t total_count_{0};
+  uint64_t max_{0};
+};
+
+/**
+ * @brief Records the time from its construction to its destruction into a histogram
+ *
+ */
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(LatencyHistogram & histogram)
+  : histogram_(histogram), start_(std::chrono::steady_clock::now())
+  {
+  }
+  ~ScopedTimer()
+  {
+    histogram_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count());
+  }
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+private:
+  LatencyHistogram & histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief per-stage latencies and per-frame counts of the camera_info callback of one camera,
+ * since the last time they were published
+ *
+ */
+struct StageMetrics
+{
+  LatencyHistogram tf_lookup;
+  LatencyHistogram culling;
+  LatencyHistogram roi_projection;
+  LatencyHistogram publish;
+  LatencyHistogram markers;
+  LatencyHistogram total;
+  uint64_t frame_count{0};
+  uint64_t candidate_count{0};
+  uint64_t visible_count{0};
+  uint64_t roi_count{0};
+
+  void reset();
+};
+}  // namespace traffic_mirror
+
+// the instrumentation compiles to nothing without TRAFFIC_MIRROR_ENABLE_STAGE_METRICS
+#ifdef TRAFFIC_MIRROR_ENABLE_STAGE_METRICS
+#define TRAFFIC_MIRROR_STAGE_METRICS_CONCAT_IMPL(a, b) a##b
+#define TRAFFIC_MIRROR_STAGE_METRICS_CONCAT(a, b) TRAFFIC_MIRROR_STAGE_METRICS_CONCAT_IMPL(a, b)
+#define TRAFFIC_MIRROR_SCOPED_TIMER(histogram)                                          \
+  const ::traffic_mirror::ScopedTimer TRAFFIC_MIRROR_STAGE_METRICS_CONCAT(scoped_timer_, \
+                                                                          __LINE__)(histogram)
+#define TRAFFIC_MIRROR_COUNT(counter, value) ((counter) += (value))
+#else
+#define TRAFFIC_MIRROR_SCOPED_TIMER(histogram) static_cast<void>(0)
+#define TRAFFIC_MIRROR_COUNT(counter, value) static_cast<void>(0)
+#endif
+
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__STAGE_METRICS_HPP_
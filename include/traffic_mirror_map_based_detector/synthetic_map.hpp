@@ -0,0 +1,123 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SYNTHETIC_MAP_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SYNTHETIC_MAP_HPP_
+
+#include <autoware_auto_mapping_msgs/msg/had_map_bin.hpp>
+#include <autoware_planning_msgs/msg/lanelet_route.hpp>
+
+#include <lanelet2_core/LaneletMap.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief parameters of a synthetic map: a grid of two-way roads with traffic mirrors along them
+ *
+ */
+struct SyntheticMapConfig
+{
+  /**
+   * @brief number of intersections along x and y
+   *
+   */
+  size_t grid_cols{10};
+  size_t grid_rows{10};
+  /**
+   * @brief distance between two neighbouring intersections
+   *
+   */
+  double block_length{100.0};
+  double lane_width{3.5};
+  /**
+   * @brief mean number of traffic mirrors along one lanelet. Each lanelet gets the integer part,
+   * plus one more with the probability of the fractional part
+   *
+   */
+  double traffic_mirrors_per_lanelet{1.0};
+  /**
+   * @brief range of the height of the mirror line strings above the road, and of their "height"
+   * attribute
+   *
+   */
+  double min_mount_height{1.5};
+  double max_mount_height{3.0};
+  double min_height{0.6};
+  double max_height{1.0};
+  double traffic_mirror_width{0.8};
+  /**
+   * @brief subtypes of the detectable traffic mirrors, drawn uniformly
+   *
+   */
+  std::vector<std::string> subtypes{"round", "rectangle"};
+  /**
+   * @brief ratio of the traffic mirrors with the "solid" subtype, which are not detected
+   *
+   */
+  double solid_ratio{0.1};
+  /**
+   * @brief number of lanelets of the route, snaking along the rows of the grid. 0 for no route
+   *
+   */
+  size_t route_lanelet_num{20};
+  uint32_t seed{1};
+};
+
+/**
+ * @brief a synthetic map and the lanelets of its route
+ *
+ */
+struct SyntheticMap
+{
+  lanelet::LaneletMapPtr lanelet_map;
+  std::vector<lanelet::Id> route_lanelet_ids;
+  size_t traffic_mirror_num{0};
+  size_t solid_traffic_mirror_num{0};
+};
+
+/**
+ * @brief Generate a lanelet map with one AutowareTrafficMirror regulatory element per traffic
+ * mirror. The same config gives the same map
+ *
+ * @param config   parameters of the map
+ * @return         the map and its route
+ */
+SyntheticMap generateSyntheticMap(const SyntheticMapConfig & config);
+
+/**
+ * @brief Serialize a synthetic map as the map loader does
+ *
+ * @param map        synthetic map
+ * @param frame_id   frame of the message
+ * @return           map message
+ */
+autoware_auto_mapping_msgs::msg::HADMapBin toHADMapBin(
+  const SyntheticMap & map, const std::string & frame_id = "map");
+
+/**
+ * @brief Build the route of a synthetic map, one segment per lanelet
+ *
+ * @param map        synthetic map
+ * @param frame_id   frame of the message
+ * @return           route message, without segments if the map has no route
+ */
+autoware_planning_msgs::msg::LaneletRoute toLaneletRoute(
+  const SyntheticMap & map, const std::string & frame_id = "map");
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__SYNTHETIC_MAP_HPP_
@@ -0,0 +1,70 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_CACHE_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_CACHE_HPP_
+
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Hash of the map payload (64 bit FNV-1a), identifies the map the cache was built from
+ *
+ * @param data    serialized map
+ * @return        hash of data
+ */
+uint64_t hashMapPayload(const std::vector<uint8_t> & data);
+
+/**
+ * @brief Path of the cache file of a map
+ *
+ * @param cache_dir   cache directory
+ * @param map_hash    hash of the map payload
+ * @return            path of the cache file
+ */
+std::string makeTrafficMirrorCachePath(const std::string & cache_dir, const uint64_t map_hash);
+
+/**
+ * @brief Read the traffic mirror table from a cache file. The file is memory mapped and checked
+ * against the format version, the map hash and its expected size before anything is copied
+ *
+ * @param path      path of the cache file
+ * @param map_hash  hash of the map payload the table must belong to
+ * @param table     read table
+ * @return true     the table is read
+ * @return false    the file does not exist, belongs to another map or version, or is corrupt
+ */
+bool readTrafficMirrorCache(
+  const std::string & path, const uint64_t map_hash, TrafficMirrorTable & table);
+
+/**
+ * @brief Write the traffic mirror table to a cache file. The file is written to a unique
+ * temporary file next to its final path, synced and renamed into place, so a reader never sees a
+ * partial file even if several detectors write the same cache
+ *
+ * @param path      path of the cache file, its directory is created if needed
+ * @param map_hash  hash of the map payload the table belongs to
+ * @param table     table to write
+ * @return true     the file is written
+ * @return false    the file could not be written
+ */
+bool writeTrafficMirrorCache(
+  const std::string & path, const uint64_t map_hash, const TrafficMirrorTable & table);
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_CACHE_HPP_
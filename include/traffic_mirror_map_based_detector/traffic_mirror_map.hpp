@@ -0,0 +1,67 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_MAP_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_MAP_HPP_
+
+#include "traffic_mirror_map_based_detector/traffic_mirror_table.hpp"
+
+#include <rclcpp/logger.hpp>
+
+#include <autoware_planning_msgs/msg/lanelet_route.hpp>
+
+#include <lanelet2_core/LaneletMap.h>
+
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Extract the traffic mirrors of the traffic mirror regulatory elements of lanelets
+ *
+ * @param lanelets   lanelets
+ * @return           table of all the traffic mirrors referenced by the lanelets, ordered by id
+ */
+TrafficMirrorTable buildTrafficMirrorTable(const lanelet::ConstLanelets & lanelets);
+
+/**
+ * @brief Get the lanelets of a route that are in the map. The missing ones are logged
+ *
+ * @param lanelet_map             map the route was planned on
+ * @param route_msg               route
+ * @param skip_unknown_lanelets   skip the lanelets of the route that are not in the map, else fail
+ * @param logger                  logger of the missing lanelets
+ * @param lanelet_ids             ids of the lanelets of the route in the map
+ * @param missing_lanelet_num     number of lanelets of the route that are not in the map
+ * @return                        false if a lanelet is not in the map and is not skipped
+ */
+bool getRouteLaneletIds(
+  const lanelet::LaneletMap & lanelet_map,
+  const autoware_planning_msgs::msg::LaneletRoute & route_msg, const bool skip_unknown_lanelets,
+  const rclcpp::Logger & logger, std::unordered_set<lanelet::Id> & lanelet_ids,
+  size_t & missing_lanelet_num);
+
+/**
+ * @brief Get the traffic mirrors some lanelets refer to
+ *
+ * @param traffic_mirrors   traffic mirror table
+ * @param lanelet_ids       ids of the lanelets
+ * @return                  sorted indices of their traffic mirrors in the table
+ */
+std::vector<size_t> getLaneletTrafficMirrors(
+  const TrafficMirrorTable & traffic_mirrors, const std::unordered_set<lanelet::Id> & lanelet_ids);
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_MAP_HPP_
@@ -0,0 +1,121 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_TABLE_HPP_
+#define TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_TABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Geometry of the traffic mirrors, derived once from the lanelet map and stored as
+ * structure of arrays so the per-frame processing only reads contiguous doubles
+ *
+ */
+struct TrafficMirrorTable
+{
+  std::vector<int64_t> ids;
+  /**
+   * @brief front point of the line string raised by the "height" attribute
+   *
+   */
+  std::vector<double> top_left_x;
+  std::vector<double> top_left_y;
+  std::vector<double> top_left_z;
+  /**
+   * @brief back point of the line string
+   *
+   */
+  std::vector<double> bottom_right_x;
+  std::vector<double> bottom_right_y;
+  std::vector<double> bottom_right_z;
+  std::vector<double> center_x;
+  std::vector<double> center_y;
+  std::vector<double> center_z;
+  /**
+   * @brief unit vector of the direction the traffic mirror faces, in the map xy plane
+   *
+   */
+  std::vector<double> facing_x;
+  std::vector<double> facing_y;
+  /**
+   * @brief 0 if the traffic mirror has no subtype or is "solid" and must not be detected
+   *
+   */
+  std::vector<uint8_t> is_valid;
+  /**
+   * @brief lanelet_ids[lanelet_offsets[i] .. lanelet_offsets[i + 1]) are the lanelets whose
+   * regulatory elements refer to traffic mirror i. lanelet_offsets has size() + 1 entries
+   *
+   */
+  std::vector<uint64_t> lanelet_offsets{0};
+  std::vector<int64_t> lanelet_ids;
+
+  size_t size() const { return ids.size(); }
+
+  void reserve(const size_t n)
+  {
+    ids.reserve(n);
+    top_left_x.reserve(n);
+    top_left_y.reserve(n);
+    top_left_z.reserve(n);
+    bottom_right_x.reserve(n);
+    bottom_right_y.reserve(n);
+    bottom_right_z.reserve(n);
+    center_x.reserve(n);
+    center_y.reserve(n);
+    center_z.reserve(n);
+    facing_x.reserve(n);
+    facing_y.reserve(n);
+    is_valid.reserve(n);
+    lanelet_offsets.reserve(n + 1);
+  }
+
+  /**
+   * @brief Copy some of the traffic mirrors into a new table
+   *
+   * @param indices   indices of the traffic mirrors to copy, in the order of the new table
+   * @return          table of the selected traffic mirrors
+   */
+  TrafficMirrorTable select(const std::vector<size_t> & indices) const
+  {
+    TrafficMirrorTable table;
+    table.reserve(indices.size());
+    for (const size_t i : indices) {
+      table.ids.push_back(ids[i]);
+      table.top_left_x.push_back(top_left_x[i]);
+      table.top_left_y.push_back(top_left_y[i]);
+      table.top_left_z.push_back(top_left_z[i]);
+      table.bottom_right_x.push_back(bottom_right_x[i]);
+      table.bottom_right_y.push_back(bottom_right_y[i]);
+      table.bottom_right_z.push_back(bottom_right_z[i]);
+      table.center_x.push_back(center_x[i]);
+      table.center_y.push_back(center_y[i]);
+      table.center_z.push_back(center_z[i]);
+      table.facing_x.push_back(facing_x[i]);
+      table.facing_y.push_back(facing_y[i]);
+      table.is_valid.push_back(is_valid[i]);
+      table.lanelet_ids.insert(
+        table.lanelet_ids.end(), lanelet_ids.begin() + lanelet_offsets[i],
+        lanelet_ids.begin() + lanelet_offsets[i + 1]);
+      table.lanelet_offsets.push_back(table.lanelet_ids.size());
+    }
+    return table;
+  }
+};
+}  // namespace traffic_mirror
+#endif  // TRAFFIC_MIRROR_MAP_BASED_DETECTOR__TRAFFIC_MIRROR_TABLE_HPP_
@@ -0,0 +1,72 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/debug_markers.hpp"
+
+#include <rclcpp/duration.hpp>
+
+#include <geometry_msgs/msg/point.hpp>
+
+#include <string>
+
+namespace traffic_mirror
+{
+visualization_msgs::msg::MarkerArray makeVisibleTrafficMirrorMarkers(
+  const CameraPose & camera_pose, const std_msgs::msg::Header & cam_info_header,
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible_traffic_mirrors)
+{
+  visualization_msgs::msg::MarkerArray output_msg;
+  output_msg.markers.reserve(visible_traffic_mirrors.size());
+  for (const size_t traffic_mirror : visible_traffic_mirrors) {
+    const int id = traffic_mirrors.ids[traffic_mirror];
+    const Eigen::Vector3d center(
+      traffic_mirrors.center_x[traffic_mirror], traffic_mirrors.center_y[traffic_mirror],
+      traffic_mirrors.center_z[traffic_mirror]);
+    const Eigen::Vector3d camera2tl = camera_pose.tf_camera2map * center;
+
+    visualization_msgs::msg::Marker marker;
+    marker.header = cam_info_header;
+    marker.id = id;
+    marker.type = visualization_msgs::msg::Marker::LINE_LIST;
+    marker.ns = std::string("beam");
+    marker.scale.x = 0.05;
+    marker.action = visualization_msgs::msg::Marker::MODIFY;
+    marker.pose.position.x = 0.0;
+    marker.pose.position.y = 0.0;
+    marker.pose.position.z = 0.0;
+    marker.pose.orientation.x = 0.0;
+    marker.pose.orientation.y = 0.0;
+    marker.pose.orientation.z = 0.0;
+    marker.pose.orientation.w = 1.0;
+    geometry_msgs::msg::Point point;
+    point.x = 0.0;
+    point.y = 0.0;
+    point.z = 0.0;
+    marker.points.push_back(point);
+    point.x = camera2tl.x();
+    point.y = camera2tl.y();
+    point.z = camera2tl.z();
+    marker.points.push_back(point);
+
+    marker.lifetime = rclcpp::Duration::from_seconds(0.2);
+    marker.color.a = 0.999;  // Don't forget to set the alpha!
+    marker.color.r = 0.0;
+    marker.color.g = 1.0;
+    marker.color.b = 0.0;
+
+    output_msg.markers.push_back(marker);
+  }
+  return output_msg;
+}
+}  // namespace traffic_mirror
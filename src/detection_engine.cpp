@@ -0,0 +1,619 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+traffic_mirror::ImageBounds makeImageBounds(const traffic_mirror::CameraIntrinsics & intrinsics)
+{
+  traffic_mirror::ImageBounds image_bounds;
+  image_bounds.width = intrinsics.width;
+  image_bounds.height = intrinsics.height;
+  image_bounds.max_x = static_cast<double>(static_cast<int>(intrinsics.width) - 1);
+  image_bounds.max_y = static_cast<double>(static_cast<int>(intrinsics.height) - 1);
+  return image_bounds;
+}
+
+void roundInImageFrame(const traffic_mirror::ImageBounds & image_bounds, double & u, double & v)
+{
+  u = std::max(std::min(u, image_bounds.max_x), 0.0);
+  v = std::max(std::min(v, image_bounds.max_y), 0.0);
+}
+
+/**
+ * @brief grow roi to the bounding box of itself and other
+ *
+ */
+void mergeRoi(const traffic_mirror::Roi & other, traffic_mirror::Roi & roi)
+{
+  const uint32_t x1 = std::min(roi.x_offset, other.x_offset);
+  const uint32_t x2 = std::max(roi.x_offset + roi.width, other.x_offset + other.width);
+  const uint32_t y1 = std::min(roi.y_offset, other.y_offset);
+  const uint32_t y2 = std::max(roi.y_offset + roi.height, other.y_offset + other.height);
+  roi.x_offset = x1;
+  roi.y_offset = y1;
+  roi.width = x2 - x1;
+  roi.height = y2 - y1;
+}
+
+traffic_mirror::RigidTransform toRigidTransform(const Eigen::Isometry3d & tf)
+{
+  traffic_mirror::RigidTransform rigid_transform;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      rigid_transform.rotation[i * 3 + j] = tf.linear()(i, j);
+    }
+    rigid_transform.translation[i] = tf.translation()(i);
+  }
+  return rigid_transform;
+}
+
+// rays of the view frustum grid per direction, uniform in angle over the checked range: about
+// 0.7 degrees apart, built once per camera model
+constexpr int frustum_grid_size = 256;
+
+bool isInDistanceRange(
+  const Eigen::Vector3d & p1, const Eigen::Vector3d & p2, const double max_distance_range)
+{
+  const double sq_dist =
+    (p1.x() - p2.x()) * (p1.x() - p2.x()) + (p1.y() - p2.y()) * (p1.y() - p2.y());
+  return sq_dist < (max_distance_range * max_distance_range);
+}
+
+// both directions are unit vectors, so the angle between them is below max_angle_range if their
+// dot product is above its cosine
+bool isInAngleRange(
+  const double tl_facing_x, const double tl_facing_y, const Eigen::Vector2d & camera_forward_xy,
+  const double cos_max_angle_range)
+{
+  return tl_facing_x * camera_forward_xy.x() + tl_facing_y * camera_forward_xy.y() >
+         cos_max_angle_range;
+}
+
+// radius of the ball a point at camera2p moves in under the motion bound. A rotation by angle a
+// moves the point by 2 * sin(a / 2) * |camera2p|, a translation by its length
+double calcMotionRadius(
+  const traffic_mirror::MotionBound & motion_bound, const Eigen::Vector3d & camera2p)
+{
+  const double rotation = std::min(motion_bound.max_rotation, M_PI);
+  return 2.0 * std::sin(rotation * 0.5) * camera2p.norm() + motion_bound.max_translation;
+}
+
+// minimum of x / z for z in [z_min, z_max], z_min > 0
+double calcMinRatio(const double x, const double z_min, const double z_max)
+{
+  return x / (x < 0.0 ? z_min : z_max);
+}
+
+// maximum of x / z for z in [z_min, z_max], z_min > 0
+double calcMaxRatio(const double x, const double z_min, const double z_max)
+{
+  return x / (x > 0.0 ? z_min : z_max);
+}
+
+Eigen::Vector3d getTrafficMirrorTopLeft(
+  const traffic_mirror::TrafficMirrorTable & traffic_mirrors, const size_t idx)
+{
+  return Eigen::Vector3d(
+    traffic_mirrors.top_left_x[idx], traffic_mirrors.top_left_y[idx],
+    traffic_mirrors.top_left_z[idx]);
+}
+
+Eigen::Vector3d getTrafficMirrorBottomRight(
+  const traffic_mirror::TrafficMirrorTable & traffic_mirrors, const size_t idx)
+{
+  return Eigen::Vector3d(
+    traffic_mirrors.bottom_right_x[idx], traffic_mirrors.bottom_right_y[idx],
+    traffic_mirrors.bottom_right_z[idx]);
+}
+
+Eigen::Vector3d getTrafficMirrorCenter(
+  const traffic_mirror::TrafficMirrorTable & traffic_mirrors, const size_t idx)
+{
+  return Eigen::Vector3d(
+    traffic_mirrors.center_x[idx], traffic_mirrors.center_y[idx], traffic_mirrors.center_z[idx]);
+}
+}  // namespace
+
+namespace traffic_mirror
+{
+CameraPose makeCameraPose(const Eigen::Isometry3d & tf_map2camera)
+{
+  CameraPose camera_pose;
+  camera_pose.tf_map2camera = tf_map2camera;
+  camera_pose.tf_camera2map = tf_map2camera.inverse();
+  // get direction of z axis
+  camera_pose.forward = tf_map2camera.linear() * Eigen::Vector3d::UnitZ();
+  const double forward_xy_norm = camera_pose.forward.head<2>().norm();
+  if (forward_xy_norm > 0.0) {
+    camera_pose.forward_xy = camera_pose.forward.head<2>() / forward_xy_norm;
+  }
+  return camera_pose;
+}
+
+PoseBundle makePoseBundle(
+  const Eigen::Isometry3d & tf_map2camera,
+  const std::vector<Eigen::Isometry3d> & tf_map2camera_vec)
+{
+  PoseBundle poses;
+  poses.exact = makeCameraPose(tf_map2camera);
+  if (tf_map2camera_vec.empty()) {
+    poses.samples.push_back(poses.exact);
+    return poses;
+  }
+  poses.samples.reserve(tf_map2camera_vec.size());
+  // bound the motion of every sampled pose relative to the exact one
+  const Eigen::Quaterniond exact_rotation(tf_map2camera.linear());
+  for (const auto & tf : tf_map2camera_vec) {
+    poses.samples.push_back(makeCameraPose(tf));
+    poses.motion_bound.max_translation = std::max(
+      poses.motion_bound.max_translation,
+      (tf.translation() - tf_map2camera.translation()).norm());
+    poses.motion_bound.max_rotation = std::max(
+      poses.motion_bound.max_rotation,
+      Eigen::Quaterniond(tf.linear()).angularDistance(exact_rotation));
+  }
+  return poses;
+}
+
+DetectionEngine::DetectionEngine(const DetectionConfig & config)
+: config_(config), cos_max_angle_range_(std::cos(config.max_angle_range))
+{
+}
+
+void DetectionEngine::setCamera(
+  const CameraIntrinsics & intrinsics, RawProjection fallback_projection)
+{
+  projector_ = CameraProjector(intrinsics);
+  fallback_projection_ = std::move(fallback_projection);
+  image_bounds_ = makeImageBounds(intrinsics);
+  view_frustum_ = makeViewFrustum(intrinsics);
+  // the corner bound of the analytic rough roi is exact without distortion and close for the
+  // mild plumb_bob polynomial. Stronger models can fold the rays far off the axis back into the
+  // image, which no corner bound catches
+  has_analytic_bound_ =
+    projector_.isSupported() &&
+    (!projector_.hasDistortion() ||
+     (intrinsics.distortion_model == "plumb_bob" && intrinsics.d.size() <= 5));
+}
+
+bool DetectionEngine::projectToRaw(const Eigen::Vector3d & point, double & u, double & v) const
+{
+  if (projector_.isSupported()) {
+    projector_.projectToRaw(point.x(), point.y(), point.z(), u, v);
+    return true;
+  }
+  if (fallback_projection_) {
+    fallback_projection_(point.x(), point.y(), point.z(), u, v);
+    return true;
+  }
+  return false;
+}
+
+bool DetectionEngine::isInImageFrame(const Eigen::Vector3d & point) const
+{
+  if (point.z() <= 0.0) {
+    return false;
+  }
+
+  double u, v;
+  if (!projectToRaw(point, u, v)) {
+    return false;
+  }
+  return 0 <= u && u < image_bounds_.width && 0 <= v && v < image_bounds_.height;
+}
+
+ViewFrustum DetectionEngine::makeViewFrustum(const CameraIntrinsics & intrinsics) const
+{
+  ViewFrustum view_frustum;
+  // with a baseline the bounds depend on the depth, such a camera is not culled
+  if (intrinsics.p[3] != 0.0 || intrinsics.p[7] != 0.0) {
+    return view_frustum;
+  }
+  // Bounding box of the slopes x / z and y / z of the grid rays that reach into the image. The
+  // whole checked range is searched rather than walking out from the image edges, because a
+  // distortion polynomial can fold rays far off the axis back into the image
+  const double step = 2.0 * ViewFrustum::max_angle / (frustum_grid_size - 1);
+  std::vector<double> slopes(frustum_grid_size);
+  for (int i = 0; i < frustum_grid_size; ++i) {
+    slopes[i] = std::tan(-ViewFrustum::max_angle + step * i);
+  }
+  int min_i = frustum_grid_size;
+  int max_i = -1;
+  int min_j = frustum_grid_size;
+  int max_j = -1;
+  for (int j = 0; j < frustum_grid_size; ++j) {
+    for (int i = 0; i < frustum_grid_size; ++i) {
+      if (isInImageFrame(Eigen::Vector3d(slopes[i], slopes[j], 1.0))) {
+        min_i = std::min(min_i, i);
+        max_i = std::max(max_i, i);
+        min_j = std::min(min_j, j);
+        max_j = std::max(max_j, j);
+      }
+    }
+  }
+  if (max_i < 0) {
+    return view_frustum;
+  }
+  // one more grid step for the rays between the grid rays
+  const auto toSlope = [step](const int i) {
+    return std::tan(std::clamp(
+      -ViewFrustum::max_angle + step * i, -ViewFrustum::max_angle, ViewFrustum::max_angle));
+  };
+  const double min_x = toSlope(min_i - 1);
+  const double max_x = toSlope(max_i + 1);
+  const double min_y = toSlope(min_j - 1);
+  const double max_y = toSlope(max_j + 1);
+  // four planes through the origin only bound the space in front of the camera if the optical
+  // axis is inside them
+  if (!(min_x < 0.0 && 0.0 < max_x && min_y < 0.0 && 0.0 < max_y)) {
+    return view_frustum;
+  }
+
+  view_frustum.inward_normals[0] = Eigen::Vector3d(1.0, 0.0, -min_x).normalized();
+  view_frustum.inward_normals[1] = Eigen::Vector3d(-1.0, 0.0, max_x).normalized();
+  view_frustum.inward_normals[2] = Eigen::Vector3d(0.0, 1.0, -min_y).normalized();
+  view_frustum.inward_normals[3] = Eigen::Vector3d(0.0, -1.0, max_y).normalized();
+  const double max_slope = std::tan(ViewFrustum::max_angle);
+  view_frustum.range_normals[0] = Eigen::Vector3d(1.0, 0.0, max_slope).normalized();
+  view_frustum.range_normals[1] = Eigen::Vector3d(-1.0, 0.0, max_slope).normalized();
+  view_frustum.range_normals[2] = Eigen::Vector3d(0.0, 1.0, max_slope).normalized();
+  view_frustum.range_normals[3] = Eigen::Vector3d(0.0, -1.0, max_slope).normalized();
+  view_frustum.is_valid = true;
+  return view_frustum;
+}
+
+bool DetectionEngine::makeRoi(
+  double top_left_u, double top_left_v, double bottom_right_u, double bottom_right_v,
+  Roi & roi) const
+{
+  roundInImageFrame(image_bounds_, top_left_u, top_left_v);
+  roundInImageFrame(image_bounds_, bottom_right_u, bottom_right_v);
+  // the distortion can fold a corner back past the other, so check the size before it is stored
+  // unsigned, a negative width would wrap to about 2^32
+  const double x_offset = std::trunc(top_left_u);
+  const double y_offset = std::trunc(top_left_v);
+  const double width = std::trunc(bottom_right_u - x_offset);
+  const double height = std::trunc(bottom_right_v - y_offset);
+  if (width < 1.0 || height < 1.0) {
+    return false;
+  }
+  roi.x_offset = static_cast<uint32_t>(x_offset);
+  roi.y_offset = static_cast<uint32_t>(y_offset);
+  roi.width = static_cast<uint32_t>(width);
+  roi.height = static_cast<uint32_t>(height);
+  return true;
+}
+
+void DetectionEngine::getCandidateTrafficMirrors(
+  const SpatialGrid & grid, const PoseBundle & poses, std::vector<size_t> & candidates) const
+{
+  // only the traffic mirrors around the camera origins can be in distance range
+  double min_x = std::numeric_limits<double>::max();
+  double min_y = std::numeric_limits<double>::max();
+  double max_x = std::numeric_limits<double>::lowest();
+  double max_y = std::numeric_limits<double>::lowest();
+  for (const auto & camera_pose : poses.samples) {
+    min_x = std::min(min_x, camera_pose.tf_map2camera.translation().x());
+    min_y = std::min(min_y, camera_pose.tf_map2camera.translation().y());
+    max_x = std::max(max_x, camera_pose.tf_map2camera.translation().x());
+    max_y = std::max(max_y, camera_pose.tf_map2camera.translation().y());
+  }
+  const size_t first_new = candidates.size();
+  grid.query(
+    min_x - config_.max_detection_range, min_y - config_.max_detection_range,
+    max_x + config_.max_detection_range, max_y + config_.max_detection_range, candidates);
+  // keep the id order of the output
+  std::sort(candidates.begin() + first_new, candidates.end());
+}
+
+void DetectionEngine::getVisibleTrafficMirrors(
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & candidates,
+  const PoseBundle & poses, std::vector<size_t> & visible) const
+{
+  for (const size_t traffic_mirror : candidates) {
+    if (!traffic_mirrors.is_valid[traffic_mirror]) {
+      continue;
+    }
+    // check distance range
+    const Eigen::Vector3d tl_center = getTrafficMirrorCenter(traffic_mirrors, traffic_mirror);
+    // both corners are in the ball around the center through them
+    const double sq_radius = 0.25 * (getTrafficMirrorTopLeft(traffic_mirrors, traffic_mirror) -
+                                     getTrafficMirrorBottomRight(traffic_mirrors, traffic_mirror))
+                                      .squaredNorm();
+    // for every possible transformation, check if the tl is visible.
+    // If under any tf the tl is visible, keep it
+    for (const auto & camera_pose : poses.samples) {
+      if (!isInDistanceRange(
+            tl_center, camera_pose.tf_map2camera.translation(), config_.max_detection_range)) {
+        continue;
+      }
+
+      // reject the traffic mirrors off the image with a few dot products, cheaper than the angle
+      // check and the projection
+      if (
+        config_.view_frustum_culling &&
+        !view_frustum_.intersects(camera_pose.tf_camera2map * tl_center, sq_radius)) {
+        continue;
+      }
+
+      // check angle range
+      if (!isInAngleRange(
+            traffic_mirrors.facing_x[traffic_mirror], traffic_mirrors.facing_y[traffic_mirror],
+            camera_pose.forward_xy, cos_max_angle_range_)) {
+        continue;
+      }
+
+      // check within image frame
+      const Eigen::Vector3d camera2tltl =
+        camera_pose.tf_camera2map * getTrafficMirrorTopLeft(traffic_mirrors, traffic_mirror);
+      const Eigen::Vector3d camera2tlbr =
+        camera_pose.tf_camera2map * getTrafficMirrorBottomRight(traffic_mirrors, traffic_mirror);
+      if (!isInImageFrame(camera2tltl) && !isInImageFrame(camera2tlbr)) {
+        continue;
+      }
+      visible.push_back(traffic_mirror);
+      break;
+    }
+  }
+}
+
+bool DetectionEngine::getTrafficMirrorRoi(
+  const CameraPose & camera_pose, const TrafficMirrorTable & traffic_mirrors,
+  const size_t traffic_mirror, const VibrationBound & vibration, Roi & roi) const
+{
+  double top_left_u, top_left_v, bottom_right_u, bottom_right_v;
+
+  // for roi.x_offset and roi.y_offset
+  {
+    const Eigen::Vector3d camera2tl =
+      camera_pose.tf_camera2map * getTrafficMirrorTopLeft(traffic_mirrors, traffic_mirror);
+    // max vibration
+    const double max_vibration_x = std::sin(vibration.max_vibration_yaw * 0.5) * camera2tl.z() +
+                                   vibration.max_vibration_width * 0.5;
+    const double max_vibration_y = std::sin(vibration.max_vibration_pitch * 0.5) * camera2tl.z() +
+                                   vibration.max_vibration_height * 0.5;
+    const double max_vibration_z = vibration.max_vibration_depth * 0.5;
+    // enlarged target position in camera coordinate
+    const Eigen::Vector3d point3d =
+      camera2tl - Eigen::Vector3d(max_vibration_x, max_vibration_y, max_vibration_z);
+    if (point3d.z() <= 0.0 || !projectToRaw(point3d, top_left_u, top_left_v)) {
+      return false;
+    }
+  }
+
+  // for roi.width and roi.height
+  {
+    const Eigen::Vector3d camera2br =
+      camera_pose.tf_camera2map * getTrafficMirrorBottomRight(traffic_mirrors, traffic_mirror);
+    // max vibration
+    const double max_vibration_x = std::sin(vibration.max_vibration_yaw * 0.5) * camera2br.z() +
+                                   vibration.max_vibration_width * 0.5;
+    const double max_vibration_y = std::sin(vibration.max_vibration_pitch * 0.5) * camera2br.z() +
+                                   vibration.max_vibration_height * 0.5;
+    const double max_vibration_z = vibration.max_vibration_depth * 0.5;
+    // enlarged target position in camera coordinate
+    const Eigen::Vector3d point3d =
+      camera2br + Eigen::Vector3d(max_vibration_x, max_vibration_y, -max_vibration_z);
+    if (point3d.z() <= 0.0 || !projectToRaw(point3d, bottom_right_u, bottom_right_v)) {
+      return false;
+    }
+  }
+  return makeRoi(top_left_u, top_left_v, bottom_right_u, bottom_right_v, roi);
+}
+
+bool DetectionEngine::getTrafficMirrorRoi(
+  const std::vector<CameraPose> & camera_poses, const TrafficMirrorTable & traffic_mirrors,
+  const size_t traffic_mirror, const VibrationBound & vibration, Roi & out_roi) const
+{
+  // the maximum possible rough roi among all the poses, accumulated on the fly
+  bool has_roi = false;
+  Roi roi;
+  for (const auto & camera_pose : camera_poses) {
+    if (!getTrafficMirrorRoi(camera_pose, traffic_mirrors, traffic_mirror, vibration, roi)) {
+      continue;
+    }
+    if (!has_roi) {
+      out_roi = roi;
+      has_roi = true;
+    } else {
+      mergeRoi(roi, out_roi);
+    }
+  }
+  return has_roi;
+}
+
+bool DetectionEngine::projectCornerBound(
+  const Eigen::Vector3d & camera2corner, const MotionBound & motion_bound,
+  const VibrationBound & vibration, const double sign, double & u, double & v) const
+{
+  // the corner stays within this distance of camera2corner under every pose of the window
+  const double motion_radius = calcMotionRadius(motion_bound, camera2corner);
+  // max vibration, the angular part grows with the depth
+  const double max_depth = camera2corner.z() + motion_radius;
+  const double max_vibration_x =
+    std::sin(vibration.max_vibration_yaw * 0.5) * max_depth + vibration.max_vibration_width * 0.5;
+  const double max_vibration_y = std::sin(vibration.max_vibration_pitch * 0.5) * max_depth +
+                                 vibration.max_vibration_height * 0.5;
+  const double max_vibration_z = vibration.max_vibration_depth * 0.5;
+  // box of the enlarged target positions in camera coordinate. The vibration only pushes the
+  // corner outwards, so the inner side of the box is bounded by the motion alone
+  const double outer_x = camera2corner.x() + sign * (motion_radius + max_vibration_x);
+  const double outer_y = camera2corner.y() + sign * (motion_radius + max_vibration_y);
+  const double z_min = camera2corner.z() - motion_radius - max_vibration_z;
+  const double z_max = camera2corner.z() + motion_radius - max_vibration_z;
+  if (z_min <= 0.0) {
+    return false;
+  }
+  const auto outer_ratio = [&](const double p) {
+    return sign < 0.0 ? calcMinRatio(p, z_min, z_max) : calcMaxRatio(p, z_min, z_max);
+  };
+  if (!projector_.hasDistortion()) {
+    // without distortion the projection is monotonic in x / z and y / z, so the outermost
+    // ratios are the outermost pixel
+    return projectToRaw(Eigen::Vector3d(outer_ratio(outer_x), outer_ratio(outer_y), 1.0), u, v);
+  }
+  // The distortion bends the box edges and can turn its image, so the outermost pixel is taken
+  // over the four corners of the ratio box. setCamera only allows it for plumb_bob, which is
+  // close to linear over the small box of one traffic mirror
+  const auto inner_ratio = [&](const double p) {
+    return sign < 0.0 ? calcMaxRatio(p, z_min, z_max) : calcMinRatio(p, z_min, z_max);
+  };
+  const double ratio_x[2] = {
+    outer_ratio(outer_x), inner_ratio(camera2corner.x() - sign * motion_radius)};
+  const double ratio_y[2] = {
+    outer_ratio(outer_y), inner_ratio(camera2corner.y() - sign * motion_radius)};
+  for (int i = 0; i < 4; ++i) {
+    double corner_u, corner_v;
+    if (!projectToRaw(Eigen::Vector3d(ratio_x[i % 2], ratio_y[i / 2], 1.0), corner_u, corner_v)) {
+      return false;
+    }
+    if (i == 0 || sign * (corner_u - u) > 0.0) {
+      u = corner_u;
+    }
+    if (i == 0 || sign * (corner_v - v) > 0.0) {
+      v = corner_v;
+    }
+  }
+  return true;
+}
+
+bool DetectionEngine::getTrafficMirrorRoi(
+  const CameraPose & camera_pose, const MotionBound & motion_bound,
+  const TrafficMirrorTable & traffic_mirrors, const size_t traffic_mirror,
+  const VibrationBound & vibration, Roi & roi) const
+{
+  const Eigen::Vector3d camera2tl =
+    camera_pose.tf_camera2map * getTrafficMirrorTopLeft(traffic_mirrors, traffic_mirror);
+  const Eigen::Vector3d camera2br =
+    camera_pose.tf_camera2map * getTrafficMirrorBottomRight(traffic_mirrors, traffic_mirror);
+  double top_left_u, top_left_v, bottom_right_u, bottom_right_v;
+  if (
+    !projectCornerBound(camera2tl, motion_bound, vibration, -1.0, top_left_u, top_left_v) ||
+    !projectCornerBound(camera2br, motion_bound, vibration, 1.0, bottom_right_u, bottom_right_v)) {
+    return false;
+  }
+  return makeRoi(top_left_u, top_left_v, bottom_right_u, bottom_right_v, roi);
+}
+
+void DetectionEngine::getTrafficMirrorRois(
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible,
+  const PoseBundle & poses, std::vector<DetectedRoi> & rois)
+{
+  if (projector_.isSupported() && config_.batch_projection) {
+    getTrafficMirrorRoisBatch(traffic_mirrors, visible, poses, rois);
+    return;
+  }
+  // one traffic mirror at a time, with the fallback projection if the projector does not support
+  // the camera model
+  for (const size_t traffic_mirror : visible) {
+    DetectedRoi detected_roi;
+    detected_roi.traffic_mirror_id = traffic_mirrors.ids[traffic_mirror];
+    if (!getTrafficMirrorRoi(
+          poses.exact, traffic_mirrors, traffic_mirror, VibrationBound(),
+          detected_roi.expect_roi)) {
+      continue;
+    }
+    if (useAnalyticRoughRoi()) {
+      if (!getTrafficMirrorRoi(
+            poses.exact, poses.motion_bound, traffic_mirrors, traffic_mirror, config_.vibration,
+            detected_roi.rough_roi)) {
+        continue;
+      }
+    } else if (!getTrafficMirrorRoi(
+                 poses.samples, traffic_mirrors, traffic_mirror, config_.vibration,
+                 detected_roi.rough_roi)) {
+      continue;
+    }
+    rois.push_back(detected_roi);
+  }
+}
+
+void DetectionEngine::getTrafficMirrorRoisBatch(
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible,
+  const PoseBundle & poses, std::vector<DetectedRoi> & rois)
+{
+  const size_t n = visible.size();
+  roi_kernel_.setTrafficMirrors(traffic_mirrors, visible);
+  const auto makeBatchRoi = [this](const size_t i, Roi & roi) {
+    return roi_corners_.is_valid[i] &&
+           makeRoi(
+             roi_corners_.top_left_u[i], roi_corners_.top_left_v[i],
+             roi_corners_.bottom_right_u[i], roi_corners_.bottom_right_v[i], roi);
+  };
+
+  // expect rois, at the exact moment without enlargement. The buffers keep their capacity
+  auto & detected_rois = detected_rois_;
+  auto & has_expect = has_expect_roi_;
+  auto & has_rough = has_rough_roi_;
+  detected_rois.assign(n, DetectedRoi());
+  has_expect.assign(n, 0);
+  has_rough.assign(n, 0);
+  roi_kernel_.project(
+    toRigidTransform(poses.exact.tf_camera2map), VibrationBound(), projector_, roi_corners_);
+  for (size_t i = 0; i < n; ++i) {
+    detected_rois[i].traffic_mirror_id = traffic_mirrors.ids[visible[i]];
+    has_expect[i] = makeBatchRoi(i, detected_rois[i].expect_roi);
+  }
+
+  // rough rois
+  if (useAnalyticRoughRoi()) {
+    for (size_t i = 0; i < n; ++i) {
+      has_rough[i] = has_expect[i] && getTrafficMirrorRoi(
+                                        poses.exact, poses.motion_bound, traffic_mirrors,
+                                        visible[i], config_.vibration, detected_rois[i].rough_roi);
+    }
+  } else {
+    Roi roi;
+    for (const auto & camera_pose : poses.samples) {
+      roi_kernel_.project(
+        toRigidTransform(camera_pose.tf_camera2map), config_.vibration, projector_, roi_corners_);
+      for (size_t i = 0; i < n; ++i) {
+        if (!makeBatchRoi(i, roi)) {
+          continue;
+        }
+        if (!has_rough[i]) {
+          detected_rois[i].rough_roi = roi;
+          has_rough[i] = 1;
+        } else {
+          mergeRoi(roi, detected_rois[i].rough_roi);
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    if (has_expect[i] && has_rough[i]) {
+      rois.push_back(detected_rois[i]);
+    }
+  }
+}
+
+void DetectionEngine::detect(
+  const TrafficMirrorTable & traffic_mirrors, const SpatialGrid & grid, const PoseBundle & poses,
+  std::vector<DetectedRoi> & rois)
+{
+  candidates_.clear();
+  visible_.clear();
+  getCandidateTrafficMirrors(grid, poses, candidates_);
+  getVisibleTrafficMirrors(traffic_mirrors, candidates_, poses, visible_);
+  getTrafficMirrorRois(traffic_mirrors, visible_, poses, rois);
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,105 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/detector_params.hpp"
+
+#include <rclcpp/logging.hpp>
+
+#include <cmath>
+#include <string>
+
+namespace traffic_mirror
+{
+DetectorParams declareDetectorParams(rclcpp::Node & node)
+{
+  DetectorParams params;
+  DetectionConfig & detection = params.detection;
+  TimestampSampling & sampling = params.sampling;
+
+  // parameter declaration needs default values: are 0.0 good defaults for this?
+  detection.vibration.max_vibration_pitch =
+    node.declare_parameter<double>("max_vibration_pitch", 0.0);
+  detection.vibration.max_vibration_yaw = node.declare_parameter<double>("max_vibration_yaw", 0.0);
+  detection.vibration.max_vibration_height =
+    node.declare_parameter<double>("max_vibration_height", 0.0);
+  detection.vibration.max_vibration_width =
+    node.declare_parameter<double>("max_vibration_width", 0.0);
+  detection.vibration.max_vibration_depth =
+    node.declare_parameter<double>("max_vibration_depth", 0.0);
+  sampling.min_timestamp_offset = node.declare_parameter<double>("min_timestamp_offset", 0.0);
+  sampling.max_timestamp_offset = node.declare_parameter<double>("max_timestamp_offset", 0.0);
+  sampling.timestamp_sample_len = node.declare_parameter<double>("timestamp_sample_len", 0.01);
+  detection.max_detection_range = node.declare_parameter<double>("max_detection_range", 200.0);
+  detection.max_angle_range = node.declare_parameter<double>("max_angle_range", 0.6981317008);
+  sampling.adaptive_sampling = node.declare_parameter<bool>("adaptive_sampling", false);
+  sampling.adaptive_sampling_max_angle_step =
+    node.declare_parameter<double>("adaptive_sampling_max_angle_step", 0.001);
+  sampling.adaptive_sampling_max_translation_step =
+    node.declare_parameter<double>("adaptive_sampling_max_translation_step", 0.1);
+  const std::string rough_roi_mode =
+    node.declare_parameter<std::string>("rough_roi_mode", "sampling");
+
+  if (detection.max_detection_range <= 0) {
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(), "Invalid param max_detection_range = " << detection.max_detection_range
+                                                                << ", set to default value = 200");
+    detection.max_detection_range = 200.0;
+  }
+  if (detection.max_angle_range <= 0 || detection.max_angle_range > M_PI) {
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(), "Invalid param max_angle_range = "
+                           << detection.max_angle_range << ", set to default value = 0.6981317008");
+    detection.max_angle_range = 0.6981317008;
+  }
+  if (sampling.timestamp_sample_len <= 0) {
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(), "Invalid param timestamp_sample_len = "
+                           << sampling.timestamp_sample_len << ", set to default value = 0.01");
+    sampling.timestamp_sample_len = 0.01;
+  }
+  // 수정: 값이 동일한 경우는 허용 (작은 경우에만 0으로 세팅) #KMS_250318
+  if (sampling.max_timestamp_offset < sampling.min_timestamp_offset) { //KMS_250318
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(),
+      "max_timestamp_offset < min_timestamp_offset. Set both to 0"); //KMS_250318
+    sampling.max_timestamp_offset = 0.0; //KMS_250318
+    sampling.min_timestamp_offset = 0.0; //KMS_250318
+  }
+  if (sampling.adaptive_sampling_max_angle_step <= 0) {
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(), "Invalid param adaptive_sampling_max_angle_step = "
+                           << sampling.adaptive_sampling_max_angle_step
+                           << ", set to default value = 0.001");
+    sampling.adaptive_sampling_max_angle_step = 0.001;
+  }
+  if (sampling.adaptive_sampling_max_translation_step <= 0) {
+    RCLCPP_ERROR_STREAM(
+      node.get_logger(), "Invalid param adaptive_sampling_max_translation_step = "
+                           << sampling.adaptive_sampling_max_translation_step
+                           << ", set to default value = 0.1");
+    sampling.adaptive_sampling_max_translation_step = 0.1;
+  }
+  if (rough_roi_mode == "analytic") {
+    detection.rough_roi_mode = RoughRoiMode::Analytic;
+  } else {
+    if (rough_roi_mode != "sampling") {
+      RCLCPP_ERROR_STREAM(
+        node.get_logger(),
+        "Invalid param rough_roi_mode = " << rough_roi_mode << ", set to default value = sampling");
+    }
+    detection.rough_roi_mode = RoughRoiMode::Sampling;
+  }
+  return params;
+}
+}  // namespace traffic_mirror
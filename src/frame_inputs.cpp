@@ -0,0 +1,180 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+
+#include <rclcpp/duration.hpp>
+#include <tf2/LinearMath/Matrix3x3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+tf2::Transform interpolateTransform(
+  const tf2::Transform & tf_from, const tf2::Transform & tf_to, const double ratio)
+{
+  return tf2::Transform(
+    tf_from.getRotation().slerp(tf_to.getRotation(), ratio),
+    tf_from.getOrigin().lerp(tf_to.getOrigin(), ratio));
+}
+}  // namespace
+
+namespace traffic_mirror
+{
+void sampleTransforms(
+  const TimestampSampling & sampling, const rclcpp::Time & stamp,
+  const tf2::Transform & tf_map2camera, const TransformLookup & lookup,
+  std::vector<tf2::Transform> & tf_map2camera_vec)
+{
+  const rclcpp::Time t1 = stamp + rclcpp::Duration::from_seconds(sampling.min_timestamp_offset);
+  const rclcpp::Time t2 = stamp + rclcpp::Duration::from_seconds(sampling.max_timestamp_offset);
+
+  // key poses ordered by time: the window ends and the exact moment
+  std::vector<std::pair<rclcpp::Time, tf2::Transform>> key_poses;
+  for (const auto & t : {t1, t2}) {
+    tf2::Transform tf;
+    if (t != stamp && lookup(t, tf)) {
+      key_poses.emplace_back(t, tf);
+    }
+  }
+  key_poses.emplace_back(stamp, tf_map2camera);
+  std::sort(key_poses.begin(), key_poses.end(), [](const auto & a, const auto & b) {
+    return a.first < b.first;
+  });
+  // both ends coincide if min_timestamp_offset == max_timestamp_offset, keep one of them so that
+  // no segment between key poses has zero length
+  key_poses.erase(
+    std::unique(
+      key_poses.begin(), key_poses.end(),
+      [](const auto & a, const auto & b) { return a.first == b.first; }),
+    key_poses.end());
+
+  std::vector<rclcpp::Time> sample_times;
+  if (sampling.adaptive_sampling) {
+    // pick the sample count from the camera motion over the window
+    double angle = 0.0;
+    double distance = 0.0;
+    for (size_t i = 0; i + 1 < key_poses.size(); ++i) {
+      angle += key_poses[i].second.getRotation().angleShortestPath(
+        key_poses[i + 1].second.getRotation());
+      distance += key_poses[i].second.getOrigin().distance(key_poses[i + 1].second.getOrigin());
+    }
+    const double required_intervals = std::ceil(std::max(
+      angle / sampling.adaptive_sampling_max_angle_step,
+      distance / sampling.adaptive_sampling_max_translation_step));
+    const double window_len = (t2 - t1).seconds();
+    const double intervals =
+      std::min(required_intervals, std::floor(window_len / sampling.timestamp_sample_len));
+    // the camera does not move noticeably, one pose is enough
+    if (intervals < 1.0) {
+      tf_map2camera_vec.push_back(tf_map2camera);
+      return;
+    }
+    for (int i = 0; i <= static_cast<int>(intervals); ++i) {
+      sample_times.push_back(t1 + rclcpp::Duration::from_seconds(window_len * i / intervals));
+    }
+  } else {
+    rclcpp::Duration interval = rclcpp::Duration::from_seconds(sampling.timestamp_sample_len);
+    for (auto t = t1; t <= t2; t += interval) {
+      sample_times.push_back(t);
+    }
+  }
+
+  // the poses between the key poses are interpolated instead of looked up one by one
+  size_t key = 0;
+  for (const auto & t : sample_times) {
+    if (t < key_poses.front().first || key_poses.back().first < t) {
+      continue;
+    }
+    while (key + 1 < key_poses.size() && key_poses[key + 1].first < t) {
+      ++key;
+    }
+    if (key + 1 == key_poses.size()) {
+      tf_map2camera_vec.push_back(key_poses[key].second);
+      continue;
+    }
+    const auto & [time_from, tf_from] = key_poses[key];
+    const auto & [time_to, tf_to] = key_poses[key + 1];
+    const double ratio = (t - time_from).seconds() / (time_to - time_from).seconds();
+    tf_map2camera_vec.push_back(interpolateTransform(tf_from, tf_to, ratio));
+  }
+}
+
+Eigen::Isometry3d toIsometry(const tf2::Transform & tf)
+{
+  Eigen::Isometry3d isometry = Eigen::Isometry3d::Identity();
+  const tf2::Matrix3x3 & basis = tf.getBasis();
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      isometry.linear()(i, j) = basis[i][j];
+    }
+    isometry.translation()(i) = tf.getOrigin()[i];
+  }
+  return isometry;
+}
+
+PoseBundle makePoseBundle(
+  const tf2::Transform & tf_map2camera, const std::vector<tf2::Transform> & tf_map2camera_vec)
+{
+  std::vector<Eigen::Isometry3d> isometry_map2camera_vec;
+  isometry_map2camera_vec.reserve(tf_map2camera_vec.size());
+  for (const auto & tf : tf_map2camera_vec) {
+    isometry_map2camera_vec.push_back(toIsometry(tf));
+  }
+  return makePoseBundle(toIsometry(tf_map2camera), isometry_map2camera_vec);
+}
+
+CameraIntrinsics makeCameraIntrinsics(const sensor_msgs::msg::CameraInfo & camera_info)
+{
+  CameraIntrinsics intrinsics;
+  intrinsics.width = camera_info.width;
+  intrinsics.height = camera_info.height;
+  intrinsics.binning_x = camera_info.binning_x;
+  intrinsics.binning_y = camera_info.binning_y;
+  intrinsics.roi_x_offset = camera_info.roi.x_offset;
+  intrinsics.roi_y_offset = camera_info.roi.y_offset;
+  intrinsics.roi_width = camera_info.roi.width;
+  intrinsics.roi_height = camera_info.roi.height;
+  intrinsics.distortion_model = camera_info.distortion_model;
+  intrinsics.d = camera_info.d;
+  std::copy(camera_info.k.begin(), camera_info.k.end(), intrinsics.k.begin());
+  std::copy(camera_info.r.begin(), camera_info.r.end(), intrinsics.r.begin());
+  std::copy(camera_info.p.begin(), camera_info.p.end(), intrinsics.p.begin());
+  return intrinsics;
+}
+
+bool hasSameIntrinsics(
+  const sensor_msgs::msg::CameraInfo & info1, const sensor_msgs::msg::CameraInfo & info2)
+{
+  return info1.width == info2.width && info1.height == info2.height &&
+         info1.binning_x == info2.binning_x && info1.binning_y == info2.binning_y &&
+         info1.roi == info2.roi && info1.k == info2.k && info1.r == info2.r &&
+         info1.p == info2.p && info1.d == info2.d &&
+         info1.distortion_model == info2.distortion_model;
+}
+
+RawProjection makeRawProjection(const image_geometry::PinholeCameraModel & pinhole_camera_model)
+{
+  return [&pinhole_camera_model](
+           const double x, const double y, const double z, double & u, double & v) {
+    const cv::Point2d rectified_image_point =
+      pinhole_camera_model.project3dToPixel(cv::Point3d(x, y, z));
+    const cv::Point2d raw_image_point = pinhole_camera_model.unrectifyPoint(rectified_image_point);
+    u = raw_image_point.x;
+    v = raw_image_point.y;
+  };
+}
+}  // namespace traffic_mirror
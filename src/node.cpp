@@ -14,11 +14,13 @@
 
 #include "traffic_mirror_map_based_detector/node.hpp"
 
+#include "traffic_mirror_map_based_detector/debug_markers.hpp"
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_map.hpp"
+
 #include <lanelet2_extension/utility/message_conversion.hpp>
 #include <lanelet2_extension/utility/utilities.hpp>
 #include <lanelet2_extension/visualization/visualization.hpp>
-#include <tier4_autoware_utils/math/normalization.hpp>
-#include <tier4_autoware_utils/math/unit_conversion.hpp>
 
 #include "tier4_perception_msgs/msg/traffic_mirror_roi_array.hpp"
 
@@ -39,83 +41,21 @@
 #include <tf2_geometry_msgs/tf2_geometry_msgs.hpp>
 #endif
 
-namespace
-{
-cv::Point2d calcRawImagePointFromPoint3D(
-  const image_geometry::PinholeCameraModel & pinhole_camera_model, const cv::Point3d & point3d)
-{
-  cv::Point2d rectified_image_point = pinhole_camera_model.project3dToPixel(point3d);
-  return pinhole_camera_model.unrectifyPoint(rectified_image_point);
-}
-
-cv::Point2d calcRawImagePointFromPoint3D(
-  const image_geometry::PinholeCameraModel & pinhole_camera_model, const tf2::Vector3 & point3d)
-{
-  return calcRawImagePointFromPoint3D(
-    pinhole_camera_model, cv::Point3d(point3d.x(), point3d.y(), point3d.z()));
-}
-
-void roundInImageFrame(
-  const image_geometry::PinholeCameraModel & pinhole_camera_model, cv::Point2d & point)
-{
-  const sensor_msgs::msg::CameraInfo camera_info = pinhole_camera_model.cameraInfo();
-  point.x =
-    std::max(std::min(point.x, static_cast<double>(static_cast<int>(camera_info.width) - 1)), 0.0);
-  point.y =
-    std::max(std::min(point.y, static_cast<double>(static_cast<int>(camera_info.height) - 1)), 0.0);
-}
-
-bool isInDistanceRange(
-  const tf2::Vector3 & p1, const tf2::Vector3 & p2, const double max_distance_range)
-{
-  const double sq_dist =
-    (p1.x() - p2.x()) * (p1.x() - p2.x()) + (p1.y() - p2.y()) * (p1.y() - p2.y());
-  return sq_dist < (max_distance_range * max_distance_range);
-}
-
-bool isInAngleRange(const double & tl_yaw, const double & camera_yaw, const double max_angle_range)
-{
-  Eigen::Vector2d vec1, vec2;
-  vec1 << std::cos(tl_yaw), std::sin(tl_yaw);
-  vec2 << std::cos(camera_yaw), std::sin(camera_yaw);
-  const double diff_angle = std::acos(vec1.dot(vec2));
-  return std::fabs(diff_angle) < max_angle_range;
-}
-
-bool isInImageFrame(
-  const image_geometry::PinholeCameraModel & pinhole_camera_model, const tf2::Vector3 & point)
-{
-  if (point.z() <= 0.0) {
-    return false;
-  }
-
-  cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point);
-  if (0 <= point2d.x && point2d.x < pinhole_camera_model.cameraInfo().width) {
-    if (0 <= point2d.y && point2d.y < pinhole_camera_model.cameraInfo().height) {
-      return true;
-    }
-  }
-  return false;
-}
-
-tf2::Vector3 getTrafficMirrorTopLeft(const lanelet::ConstLineString3d & traffic_mirror)
-{
-  const auto & tl_bl = traffic_mirror.front();
-  const double tl_height = traffic_mirror.attributeOr("height", 0.0);
-  return tf2::Vector3(tl_bl.x(), tl_bl.y(), tl_bl.z() + tl_height);
-}
+#include <chrono>
+#include <cmath>
 
-tf2::Vector3 getTrafficMirrorBottomRight(const lanelet::ConstLineString3d & traffic_mirror)
+namespace
 {
-  const auto & tl_bl = traffic_mirror.back();
-  return tf2::Vector3(tl_bl.x(), tl_bl.y(), tl_bl.z());
-}
-
-tf2::Vector3 getTrafficMirrorCenter(const lanelet::ConstLineString3d & traffic_mirror)
+tier4_perception_msgs::msg::TrafficMirrorRoi toRoiMsg(
+  const int64_t traffic_mirror_id, const traffic_mirror::Roi & roi)
 {
-  tf2::Vector3 top_left = getTrafficMirrorTopLeft(traffic_mirror);
-  tf2::Vector3 bottom_right = getTrafficMirrorBottomRight(traffic_mirror);
-  return (top_left + bottom_right) / 2;
+  tier4_perception_msgs::msg::TrafficMirrorRoi roi_msg;
+  roi_msg.traffic_mirror_id = traffic_mirror_id;
+  roi_msg.roi.x_offset = roi.x_offset;
+  roi_msg.roi.y_offset = roi.y_offset;
+  roi_msg.roi.width = roi.width;
+  roi_msg.roi.height = roi.height;
+  return roi_msg;
 }
 
 }  // namespace
@@ -129,69 +69,158 @@ MapBasedDetector::MapBasedDetector(const rclcpp::NodeOptions & node_options)
 {
   using std::placeholders::_1;
 
-  // parameter declaration needs default values: are 0.0 good defaults for this?
-  config_.max_vibration_pitch = declare_parameter<double>("max_vibration_pitch", 0.0);
-  config_.max_vibration_yaw = declare_parameter<double>("max_vibration_yaw", 0.0);
-  config_.max_vibration_height = declare_parameter<double>("max_vibration_height", 0.0);
-  config_.max_vibration_width = declare_parameter<double>("max_vibration_width", 0.0);
-  config_.max_vibration_depth = declare_parameter<double>("max_vibration_depth", 0.0);
-  config_.min_timestamp_offset = declare_parameter<double>("min_timestamp_offset", 0.0);
-  config_.max_timestamp_offset = declare_parameter<double>("max_timestamp_offset", 0.0);
-  config_.timestamp_sample_len = declare_parameter<double>("timestamp_sample_len", 0.01);
-  config_.max_detection_range = declare_parameter<double>("max_detection_range", 200.0);
+  const DetectorParams params = declareDetectorParams(*this);
+  config_.detection = params.detection;
+  config_.sampling = params.sampling;
+  config_.use_nonblocking_tf = declare_parameter<bool>("use_nonblocking_tf", false);
+  config_.max_pending_frames = declare_parameter<int>("max_pending_frames", 5);
+  config_.pending_frame_timeout = declare_parameter<double>("pending_frame_timeout", 0.2);
+  config_.traffic_mirror_cache_dir = declare_parameter<std::string>("traffic_mirror_cache_dir", "");
+  config_.route_horizon_mode = declare_parameter<bool>("route_horizon_mode", false);
+  config_.route_horizon_ahead = declare_parameter<double>("route_horizon_ahead", 300.0);
+  config_.route_horizon_behind = declare_parameter<double>("route_horizon_behind", 30.0);
+  config_.skip_unknown_route_primitives =
+    declare_parameter<bool>("skip_unknown_route_primitives", false);
+  config_.metrics_publish_period = declare_parameter<double>("metrics_publish_period", 1.0);
 
   // 디버깅을 위한 파라미터 출력 추가 #KMS_250318
   RCLCPP_INFO(get_logger(),
               "Config values: max_vibration_pitch: %f, max_vibration_yaw: %f, max_vibration_height: %f, max_vibration_width: %f, max_vibration_depth: %f, min_timestamp_offset: %f, max_timestamp_offset: %f, timestamp_sample_len: %f, max_detection_range: %f",
-              config_.max_vibration_pitch, config_.max_vibration_yaw, config_.max_vibration_height,
-              config_.max_vibration_width, config_.max_vibration_depth, config_.min_timestamp_offset,
-              config_.max_timestamp_offset, config_.timestamp_sample_len, config_.max_detection_range); //KMS_250318
-
-  if (config_.max_detection_range <= 0) {
+              config_.detection.vibration.max_vibration_pitch,
+              config_.detection.vibration.max_vibration_yaw,
+              config_.detection.vibration.max_vibration_height,
+              config_.detection.vibration.max_vibration_width,
+              config_.detection.vibration.max_vibration_depth,
+              config_.sampling.min_timestamp_offset, config_.sampling.max_timestamp_offset,
+              config_.sampling.timestamp_sample_len, config_.detection.max_detection_range); //KMS_250318
+
+  if (config_.route_horizon_ahead <= 0) {
+    RCLCPP_ERROR_STREAM(
+      get_logger(), "Invalid param route_horizon_ahead = " << config_.route_horizon_ahead
+                                                           << ", set to default value = 300");
+    config_.route_horizon_ahead = 300.0;
+  }
+  if (config_.route_horizon_behind < 0) {
     RCLCPP_ERROR_STREAM(
-      get_logger(), "Invalid param max_detection_range = " << config_.max_detection_range
-                                                           << ", set to default value = 200");
-    config_.max_detection_range = 200.0;
+      get_logger(), "Invalid param route_horizon_behind = " << config_.route_horizon_behind
+                                                            << ", set to default value = 30");
+    config_.route_horizon_behind = 30.0;
   }
-  if (config_.timestamp_sample_len <= 0) {
+  if (config_.metrics_publish_period <= 0) {
     RCLCPP_ERROR_STREAM(
-      get_logger(), "Invalid param timestamp_sample_len = " << config_.timestamp_sample_len
-                                                            << ", set to default value = 0.01");
-    config_.timestamp_sample_len = 0.01;
+      get_logger(), "Invalid param metrics_publish_period = " << config_.metrics_publish_period
+                                                              << ", set to default value = 1.0");
+    config_.metrics_publish_period = 1.0;
   }
-  // 수정: 값이 동일한 경우는 허용 (작은 경우에만 0으로 세팅) #KMS_250318
-  if (config_.max_timestamp_offset < config_.min_timestamp_offset) { //KMS_250318
+  if (config_.max_pending_frames < 1) {
     RCLCPP_ERROR_STREAM(
-      get_logger(), "max_timestamp_offset < min_timestamp_offset. Set both to 0"); //KMS_250318
-    config_.max_timestamp_offset = 0.0; //KMS_250318
-    config_.min_timestamp_offset = 0.0; //KMS_250318
+      get_logger(), "Invalid param max_pending_frames = " << config_.max_pending_frames
+                                                          << ", set to default value = 5");
+    config_.max_pending_frames = 5;
   }
 
   // subscribers
+  state_ = std::make_shared<DetectorState>();
+  map_callback_group_ = create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+  rclcpp::SubscriptionOptions map_sub_options;
+  map_sub_options.callback_group = map_callback_group_;
   map_sub_ = create_subscription<autoware_auto_mapping_msgs::msg::HADMapBin>(
     "~/input/vector_map", rclcpp::QoS{1}.transient_local(),
-    std::bind(&MapBasedDetector::mapCallback, this, _1));
-  camera_info_sub_ = create_subscription<sensor_msgs::msg::CameraInfo>(
-    "~/input/camera_info", rclcpp::SensorDataQoS(),
-    std::bind(&MapBasedDetector::cameraInfoCallback, this, _1));
+    std::bind(&MapBasedDetector::mapCallback, this, _1), map_sub_options);
   route_sub_ = create_subscription<autoware_planning_msgs::msg::LaneletRoute>(
     "~/input/route", rclcpp::QoS{1}.transient_local(),
-    std::bind(&MapBasedDetector::routeCallback, this, _1));
-
-  // publishers
-  roi_pub_ = this->create_publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>(
-    "~/output/mirror_rois", 1);
-  expect_roi_pub_ =
-    this->create_publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>("~/expect/rois", 1);
-  viz_pub_ = this->create_publisher<visualization_msgs::msg::MarkerArray>("~/debug/markers", 1);
+    std::bind(&MapBasedDetector::routeCallback, this, _1), map_sub_options);
+
+  // cameras, all sharing the map, the route and the tf buffer
+  const std::vector<std::string> camera_names =
+    declare_parameter<std::vector<std::string>>("camera_names", std::vector<std::string>());
+  if (camera_names.empty()) {
+    addCamera("", config_.sampling.min_timestamp_offset, config_.sampling.max_timestamp_offset);
+  }
+  for (const auto & camera_name : camera_names) {
+    double min_timestamp_offset = declare_parameter<double>(
+      camera_name + ".min_timestamp_offset", config_.sampling.min_timestamp_offset);
+    double max_timestamp_offset = declare_parameter<double>(
+      camera_name + ".max_timestamp_offset", config_.sampling.max_timestamp_offset);
+    if (max_timestamp_offset < min_timestamp_offset) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), camera_name << ".max_timestamp_offset < " << camera_name
+                                  << ".min_timestamp_offset. Set both to 0");
+      min_timestamp_offset = 0.0;
+      max_timestamp_offset = 0.0;
+    }
+    addCamera(camera_name, min_timestamp_offset, max_timestamp_offset);
+  }
+
+  map_worker_ = std::thread(&MapBasedDetector::runMapWorker, this);
+}
+
+MapBasedDetector::~MapBasedDetector()
+{
+  {
+    std::lock_guard<std::mutex> lock(map_worker_mutex_);
+    stop_map_worker_ = true;
+  }
+  map_worker_cv_.notify_one();
+  map_worker_.join();
+}
+
+void MapBasedDetector::addCamera(
+  const std::string & name, const double min_timestamp_offset, const double max_timestamp_offset)
+{
+  if (std::any_of(cameras_.begin(), cameras_.end(), [&name](const auto & camera) {
+        return camera->name == name;
+      })) {
+    RCLCPP_ERROR_STREAM(get_logger(), "Duplicated camera name " << name << ", ignored");
+    return;
+  }
+  auto camera = std::make_unique<CameraContext>();
+  camera->name = name;
+  camera->min_timestamp_offset = min_timestamp_offset;
+  camera->max_timestamp_offset = max_timestamp_offset;
+  camera->callback_group = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  camera->engine = DetectionEngine(config_.detection);
+  // the single camera keeps the original topic names
+  const std::string prefix = name.empty() ? "" : name + "/";
+  rclcpp::SubscriptionOptions camera_info_sub_options;
+  camera_info_sub_options.callback_group = camera->callback_group;
+  camera->camera_info_sub = create_subscription<sensor_msgs::msg::CameraInfo>(
+    "~/input/" + prefix + "camera_info", rclcpp::SensorDataQoS(),
+    [this, camera_ptr = camera.get()](const sensor_msgs::msg::CameraInfo::ConstSharedPtr msg) {
+      cameraInfoCallback(msg, *camera_ptr);
+    },
+    camera_info_sub_options);
+  // deferred frames are retried as soon as the tf they wait for has arrived
+  if (config_.use_nonblocking_tf) {
+    camera->pending_timer = rclcpp::create_timer(
+      this, get_clock(), rclcpp::Duration::from_seconds(0.01),
+      [this, camera_ptr = camera.get()]() { processPendingCameraInfos(*camera_ptr); },
+      camera->callback_group);
+  }
+  camera->roi_pub = this->create_publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>(
+    "~/output/" + prefix + "mirror_rois", 1);
+  camera->expect_roi_pub =
+    this->create_publisher<tier4_perception_msgs::msg::TrafficMirrorRoiArray>(
+      "~/expect/" + prefix + "rois", 1);
+  camera->viz_pub = this->create_publisher<visualization_msgs::msg::MarkerArray>(
+    "~/debug/" + prefix + "markers", 1);
+  // the frame counters are published even without the stage metrics. The timer shares the group
+  // of the camera, so the metrics are never read during a frame
+  camera->metrics_pub = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+    "~/debug/" + prefix + "metrics", 1);
+  camera->metrics_timer = rclcpp::create_timer(
+    this, get_clock(), rclcpp::Duration::from_seconds(config_.metrics_publish_period),
+    [this, camera_ptr = camera.get()]() { publishMetrics(*camera_ptr); }, camera->callback_group);
+  cameras_.push_back(std::move(camera));
 }
 
 bool MapBasedDetector::getTransform(
-  const rclcpp::Time & t, const std::string & frame_id, tf2::Transform & tf) const
+  const rclcpp::Time & t, const std::string & frame_id, const rclcpp::Duration & timeout,
+  tf2::Transform & tf) const
 {
   try {
     geometry_msgs::msg::TransformStamped transform =
-      tf_buffer_.lookupTransform("map", frame_id, t, rclcpp::Duration::from_seconds(0.2));
+      tf_buffer_.lookupTransform("map", frame_id, t, timeout);
     tf2::fromMsg(transform.transform, tf);
   } catch (tf2::TransformException & ex) {
     return false;
@@ -199,357 +228,523 @@ bool MapBasedDetector::getTransform(
   return true;
 }
 
+void MapBasedDetector::sampleTransforms(
+  const CameraContext & camera, const std_msgs::msg::Header & header,
+  const tf2::Transform & tf_map2camera, const rclcpp::Duration & timeout,
+  std::vector<tf2::Transform> & tf_map2camera_vec) const
+{
+  TimestampSampling sampling = config_.sampling;
+  sampling.min_timestamp_offset = camera.min_timestamp_offset;
+  sampling.max_timestamp_offset = camera.max_timestamp_offset;
+  traffic_mirror::sampleTransforms(
+    sampling, rclcpp::Time(header.stamp), tf_map2camera,
+    [this, &header, &timeout](const rclcpp::Time & t, tf2::Transform & tf) {
+      return getTransform(t, header.frame_id, timeout, tf);
+    },
+    tf_map2camera_vec);
+}
+
+bool MapBasedDetector::isTransformReady(
+  const CameraContext & camera, const sensor_msgs::msg::CameraInfo & camera_info) const
+{
+  const rclcpp::Time stamp(camera_info.header.stamp);
+  const rclcpp::Duration zero = rclcpp::Duration::from_seconds(0.0);
+  // the exact stamp and the end of the timestamp window are the latest poses needed
+  return tf_buffer_.canTransform("map", camera_info.header.frame_id, stamp, zero) &&
+         tf_buffer_.canTransform(
+           "map", camera_info.header.frame_id,
+           stamp + rclcpp::Duration::from_seconds(camera.max_timestamp_offset), zero);
+}
+
 void MapBasedDetector::cameraInfoCallback(
-  const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg)
+  const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg, CameraContext & camera)
 {
-  if (all_traffic_mirrors_ptr_ == nullptr && route_traffic_mirrors_ptr_ == nullptr) {
-    RCLCPP_DEBUG(get_logger(), "No traffic mirror data available, skipping camera callback"); //KMS_250318
+  if (!config_.use_nonblocking_tf) {
+    processCameraInfo(input_msg, camera);
+    return;
+  }
+  // keep the frame order: older deferred frames go first
+  processPendingCameraInfos(camera);
+  if (camera.pending_camera_infos.empty() && isTransformReady(camera, *input_msg)) {
+    processCameraInfo(input_msg, camera);
     return;
   }
+  ++camera.deferred_frame_count;
+  camera.pending_camera_infos.push_back(input_msg);
+  if (camera.pending_camera_infos.size() > static_cast<size_t>(config_.max_pending_frames)) {
+    camera.pending_camera_infos.pop_front();
+    ++camera.dropped_frame_count;
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 5000,
+      "pending camera_info queue of %s is full, dropped the oldest frame (deferred: %lu, "
+      "dropped: %lu)",
+      input_msg->header.frame_id.c_str(), camera.deferred_frame_count, camera.dropped_frame_count);
+  }
+}
 
-  image_geometry::PinholeCameraModel pinhole_camera_model;
-  pinhole_camera_model.fromCameraInfo(*input_msg);
+void MapBasedDetector::processPendingCameraInfos(CameraContext & camera)
+{
+  const rclcpp::Time now = this->now();
+  while (!camera.pending_camera_infos.empty()) {
+    const sensor_msgs::msg::CameraInfo::ConstSharedPtr msg = camera.pending_camera_infos.front();
+    if (isTransformReady(camera, *msg)) {
+      camera.pending_camera_infos.pop_front();
+      processCameraInfo(msg, camera);
+      continue;
+    }
+    if ((now - rclcpp::Time(msg->header.stamp)).seconds() > config_.pending_frame_timeout) {
+      camera.pending_camera_infos.pop_front();
+      ++camera.dropped_frame_count;
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 5000,
+        "tf did not arrive in time, dropped a camera_info frame of %s (deferred: %lu, dropped: "
+        "%lu)",
+        msg->header.frame_id.c_str(), camera.deferred_frame_count, camera.dropped_frame_count);
+      continue;
+    }
+    break;
+  }
+}
+
+void MapBasedDetector::processCameraInfo(
+  const sensor_msgs::msg::CameraInfo::ConstSharedPtr input_msg, CameraContext & camera)
+{
+  // the whole frame works on the snapshot of this moment, even if the map worker replaces it
+  const std::shared_ptr<const DetectorState> state = std::atomic_load(&state_);
+  if (state->all_traffic_mirrors == nullptr && state->route_traffic_mirrors == nullptr) {
+    RCLCPP_DEBUG(get_logger(), "No traffic mirror data available, skipping camera callback"); //KMS_250318
+    return;
+  }
+  TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.total);
+  TRAFFIC_MIRROR_COUNT(camera.metrics.frame_count, 1);
+
+  // the intrinsics rarely change, keep the model and its internal caches until they do
+  DetectionEngine & engine = camera.engine;
+  if (
+    !camera.pinhole_camera_model.initialized() ||
+    !hasSameIntrinsics(camera.pinhole_camera_model.cameraInfo(), *input_msg)) {
+    camera.pinhole_camera_model.fromCameraInfo(*input_msg);
+    // image_geometry covers the camera models the engine does not project inline
+    engine.setCamera(
+      makeCameraIntrinsics(*input_msg), makeRawProjection(camera.pinhole_camera_model));
+    ++camera.camera_model_rebuild_count;
+    RCLCPP_INFO(
+      get_logger(),
+      "camera model of %s is built from camera_info (rebuilds: %lu, inline distortion: %s)",
+      input_msg->header.frame_id.c_str(), camera.camera_model_rebuild_count,
+      engine.isProjectorSupported() ? "true" : "false");
+  }
 
   tier4_perception_msgs::msg::TrafficMirrorRoiArray output_msg;
   output_msg.header = input_msg->header;
   tier4_perception_msgs::msg::TrafficMirrorRoiArray expect_roi_msg;
   expect_roi_msg = output_msg;
 
+  // frames of the non-blocking path only get here once their tf is available
+  const rclcpp::Duration tf_timeout =
+    rclcpp::Duration::from_seconds(config_.use_nonblocking_tf ? 0.0 : 0.2);
+
+  /* camera pose at the exact moment*/
+  tf2::Transform tf_map2camera;
   /* Camera pose in the period*/
   std::vector<tf2::Transform> tf_map2camera_vec;
-  rclcpp::Time t1 = rclcpp::Time(input_msg->header.stamp) +
-                    rclcpp::Duration::from_seconds(config_.min_timestamp_offset);
-  rclcpp::Time t2 = rclcpp::Time(input_msg->header.stamp) +
-                    rclcpp::Duration::from_seconds(config_.max_timestamp_offset);
-  rclcpp::Duration interval = rclcpp::Duration::from_seconds(0.01);
-  for (auto t = t1; t <= t2; t += interval) {
-    tf2::Transform tf;
-    if (getTransform(t, input_msg->header.frame_id, tf)) {
-      tf_map2camera_vec.push_back(tf);
+  {
+    TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.tf_lookup);
+    if (!getTransform(
+          rclcpp::Time(input_msg->header.stamp), input_msg->header.frame_id, tf_timeout,
+          tf_map2camera)) {
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 5000, "cannot get transform from map frame to camera frame");
+      return;
     }
+    sampleTransforms(camera, input_msg->header, tf_map2camera, tf_timeout, tf_map2camera_vec);
   }
-  /* camera pose at the exact moment*/
-  tf2::Transform tf_map2camera;
-  if (!getTransform(
-        rclcpp::Time(input_msg->header.stamp), input_msg->header.frame_id, tf_map2camera)) {
-    RCLCPP_WARN_THROTTLE(
-      get_logger(), *get_clock(), 5000, "cannot get transform from map frame to camera frame");
-    return;
-  }
-  if (tf_map2camera_vec.empty()) {
-    tf_map2camera_vec.push_back(tf_map2camera);
-  }
+  // everything derived from the poses is computed once here and shared by all the stages
+  const PoseBundle poses = makePoseBundle(tf_map2camera, tf_map2camera_vec);
 
   /*
    * visible_traffic_mirrors : for each traffic mirror in map check if in range and in view angle of
    * camera
    */
-  std::vector<lanelet::ConstLineString3d> visible_traffic_mirrors;
+  std::shared_ptr<const TrafficMirrorIndex> traffic_mirrors_ptr;
   // If get a route, use only traffic mirrors on the route.
-  if (route_traffic_mirrors_ptr_ != nullptr) {
-    getVisibleTrafficMirrors(
-      *route_traffic_mirrors_ptr_, tf_map2camera_vec, pinhole_camera_model, visible_traffic_mirrors);
+  if (state->route_traffic_mirrors != nullptr) {
+    traffic_mirrors_ptr = state->route_traffic_mirrors;
     // If don't get a route, use the traffic mirrors around ego vehicle.
-  } else if (all_traffic_mirrors_ptr_ != nullptr) {
-    getVisibleTrafficMirrors(
-      *all_traffic_mirrors_ptr_, tf_map2camera_vec, pinhole_camera_model, visible_traffic_mirrors);
+  } else if (state->all_traffic_mirrors != nullptr) {
+    traffic_mirrors_ptr = state->all_traffic_mirrors;
     // This shouldn't run.
   } else {
     return;
   }
+  const TrafficMirrorTable & traffic_mirrors = traffic_mirrors_ptr->table;
+  std::vector<size_t> visible_traffic_mirrors;
+  {
+    TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.culling);
+    std::vector<size_t> candidates;
+    if (traffic_mirrors_ptr == state->route_traffic_mirrors && state->route_horizon != nullptr) {
+      // only the traffic mirrors on the route around the camera
+      const Eigen::Vector3d camera_position = poses.exact.tf_map2camera.translation();
+      camera.route_horizon_tracker.update(
+        state->route_horizon, camera_position.x(), camera_position.y(),
+        config_.route_horizon_ahead, config_.route_horizon_behind, candidates);
+    } else {
+      engine.getCandidateTrafficMirrors(traffic_mirrors_ptr->grid, poses, candidates);
+    }
+    engine.getVisibleTrafficMirrors(traffic_mirrors, candidates, poses, visible_traffic_mirrors);
+    TRAFFIC_MIRROR_COUNT(camera.metrics.candidate_count, candidates.size());
+    TRAFFIC_MIRROR_COUNT(camera.metrics.visible_count, visible_traffic_mirrors.size());
+  }
 
   /*
    * Get the ROI from the lanelet and the intrinsic matrix of camera to determine where it appears
    * in image.
    */
-  Config expect_roi_cfg = config_;
-  expect_roi_cfg.max_vibration_depth = 0;
-  expect_roi_cfg.max_vibration_height = 0;
-  expect_roi_cfg.max_vibration_width = 0;
-  expect_roi_cfg.max_vibration_yaw = 0;
-  expect_roi_cfg.max_vibration_pitch = 0;
-  for (const auto & traffic_mirror : visible_traffic_mirrors) {
-    tier4_perception_msgs::msg::TrafficMirrorRoi rough_roi, expect_roi;
-    if (!getTrafficMirrorRoi(
-          tf_map2camera, pinhole_camera_model, traffic_mirror, expect_roi_cfg, expect_roi)) {
-      continue;
-    }
-    if (!getTrafficMirrorRoi(
-          tf_map2camera_vec, pinhole_camera_model, traffic_mirror, config_, rough_roi)) {
-      continue;
+  {
+    TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.roi_projection);
+    std::vector<DetectedRoi> detected_rois;
+    engine.getTrafficMirrorRois(traffic_mirrors, visible_traffic_mirrors, poses, detected_rois);
+    output_msg.rois.reserve(detected_rois.size());
+    expect_roi_msg.rois.reserve(detected_rois.size());
+    for (const auto & detected_roi : detected_rois) {
+      output_msg.rois.push_back(toRoiMsg(detected_roi.traffic_mirror_id, detected_roi.rough_roi));
+      expect_roi_msg.rois.push_back(
+        toRoiMsg(detected_roi.traffic_mirror_id, detected_roi.expect_roi));
     }
-    output_msg.rois.push_back(rough_roi);
-    expect_roi_msg.rois.push_back(expect_roi);
+    TRAFFIC_MIRROR_COUNT(camera.metrics.roi_count, output_msg.rois.size());
   }
 
-  roi_pub_->publish(output_msg);
-  expect_roi_pub_->publish(expect_roi_msg);
-  publishVisibleTrafficMirrors(
-    tf_map2camera_vec[0], input_msg->header, visible_traffic_mirrors, viz_pub_);
+  {
+    TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.publish);
+    camera.roi_pub->publish(output_msg);
+    camera.expect_roi_pub->publish(expect_roi_msg);
+  }
+  {
+    TRAFFIC_MIRROR_SCOPED_TIMER(camera.metrics.markers);
+    publishVisibleTrafficMirrors(
+      poses.samples[0], input_msg->header, traffic_mirrors, visible_traffic_mirrors,
+      camera.viz_pub);
+  }
 }
 
-bool MapBasedDetector::getTrafficMirrorRoi(
-  const tf2::Transform & tf_map2camera,
-  const image_geometry::PinholeCameraModel & pinhole_camera_model,
-  const lanelet::ConstLineString3d traffic_mirror, const Config & config,
-  tier4_perception_msgs::msg::TrafficMirrorRoi & roi) const
+void MapBasedDetector::mapCallback(
+  const autoware_auto_mapping_msgs::msg::HADMapBin::ConstSharedPtr input_msg)
 {
-  roi.traffic_mirror_id = traffic_mirror.id();
-
-  // for roi.x_offset and roi.y_offset
+  // decoding takes seconds on large maps, leave it to the map worker
   {
-    tf2::Vector3 map2tl = getTrafficMirrorTopLeft(traffic_mirror);
-    tf2::Vector3 camera2tl = tf_map2camera.inverse() * map2tl;
-    // max vibration
-    const double max_vibration_x =
-      std::sin(config.max_vibration_yaw * 0.5) * camera2tl.z() + config.max_vibration_width * 0.5;
-    const double max_vibration_y = std::sin(config.max_vibration_pitch * 0.5) * camera2tl.z() +
-                                   config.max_vibration_height * 0.5;
-    const double max_vibration_z = config.max_vibration_depth * 0.5;
-    // enlarged target position in camera coordinate
-    {
-      tf2::Vector3 point3d =
-        camera2tl - tf2::Vector3(max_vibration_x, max_vibration_y, max_vibration_z);
-      if (point3d.z() <= 0.0) {
-        return false;
-      }
-      cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point3d);
-      roundInImageFrame(pinhole_camera_model, point2d);
-      roi.roi.x_offset = point2d.x;
-      roi.roi.y_offset = point2d.y;
-    }
+    std::lock_guard<std::mutex> lock(map_worker_mutex_);
+    pending_map_msg_ = input_msg;
   }
+  map_worker_cv_.notify_one();
+}
 
-  // for roi.width and roi.height
+void MapBasedDetector::routeCallback(
+  const autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr input_msg)
+{
+  // the route needs the map, which only the map worker has
   {
-    tf2::Vector3 map2tl = getTrafficMirrorBottomRight(traffic_mirror);
-    tf2::Vector3 camera2tl = tf_map2camera.inverse() * map2tl;
-    // max vibration
-    const double max_vibration_x =
-      std::sin(config.max_vibration_yaw * 0.5) * camera2tl.z() + config.max_vibration_width * 0.5;
-    const double max_vibration_y = std::sin(config.max_vibration_pitch * 0.5) * camera2tl.z() +
-                                   config.max_vibration_height * 0.5;
-    const double max_vibration_z = config.max_vibration_depth * 0.5;
-    // enlarged target position in camera coordinate
-    {
-      tf2::Vector3 point3d =
-        camera2tl + tf2::Vector3(max_vibration_x, max_vibration_y, -max_vibration_z);
-      if (point3d.z() <= 0.0) {
-        return false;
-      }
-      cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point3d);
-      roundInImageFrame(pinhole_camera_model, point2d);
-      roi.roi.width = point2d.x - roi.roi.x_offset;
-      roi.roi.height = point2d.y - roi.roi.y_offset;
-    }
-
-    if (roi.roi.width < 1 || roi.roi.height < 1) {
-      return false;
-    }
+    std::lock_guard<std::mutex> lock(map_worker_mutex_);
+    pending_route_msg_ = input_msg;
   }
-  return true;
+  map_worker_cv_.notify_one();
 }
 
-bool MapBasedDetector::getTrafficMirrorRoi(
-  const std::vector<tf2::Transform> & tf_map2camera_vec,
-  const image_geometry::PinholeCameraModel & pinhole_camera_model,
-  const lanelet::ConstLineString3d traffic_mirror, const Config & config,
-  tier4_perception_msgs::msg::TrafficMirrorRoi & out_roi) const
+void MapBasedDetector::runMapWorker()
 {
-  std::vector<tier4_perception_msgs::msg::TrafficMirrorRoi> rois;
-  for (const auto & tf_map2camera : tf_map2camera_vec) {
-    tier4_perception_msgs::msg::TrafficMirrorRoi roi;
-    if (getTrafficMirrorRoi(tf_map2camera, pinhole_camera_model, traffic_mirror, config, roi)) {
-      rois.push_back(roi);
+  autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr route_msg;
+  while (true) {
+    autoware_auto_mapping_msgs::msg::HADMapBin::ConstSharedPtr map_msg;
+    autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr new_route_msg;
+    {
+      std::unique_lock<std::mutex> lock(map_worker_mutex_);
+      map_worker_cv_.wait(lock, [this] {
+        return stop_map_worker_ || pending_map_msg_ != nullptr || pending_route_msg_ != nullptr;
+      });
+      if (stop_map_worker_) {
+        return;
+      }
+      map_msg = std::move(pending_map_msg_);
+      new_route_msg = std::move(pending_route_msg_);
+      pending_map_msg_ = nullptr;
+      pending_route_msg_ = nullptr;
     }
-  }
-  if (rois.empty()) {
-    return false;
-  }
-  out_roi = rois.front();
-  /**
-   * get the maximum possible rough roi among all the tf
-   */
-  uint32_t x1 = pinhole_camera_model.cameraInfo().width - 1;
-  uint32_t x2 = 0;
-  uint32_t y1 = pinhole_camera_model.cameraInfo().height - 1;
-  uint32_t y2 = 0;
-  for (const auto & roi : rois) {
-    x1 = std::min(x1, roi.roi.x_offset);
-    x2 = std::max(x2, roi.roi.x_offset + roi.roi.width);
-    y1 = std::min(y1, roi.roi.y_offset);
-    y2 = std::max(y2, roi.roi.y_offset + roi.roi.height);
-  }
-  out_roi.roi.x_offset = x1;
-  out_roi.roi.y_offset = y1;
-  out_roi.roi.width = x2 - x1;
-  out_roi.roi.height = y2 - y1;
-  return true;
-}
 
-void MapBasedDetector::mapCallback(
-  const autoware_auto_mapping_msgs::msg::HADMapBin::ConstSharedPtr input_msg)
-{
-  lanelet_map_ptr_ = std::make_shared<lanelet::LaneletMap>();
-
-  lanelet::utils::conversion::fromBinMsg(*input_msg, lanelet_map_ptr_);
-  lanelet::ConstLanelets all_lanelets = lanelet::utils::query::laneletLayer(lanelet_map_ptr_);
-  std::vector<lanelet::AutowareTrafficMirrorConstPtr> all_lanelet_traffic_mirrors =
-    lanelet::utils::query::autowareTrafficMirrors(all_lanelets);
-  all_traffic_mirrors_ptr_ = std::make_shared<MapBasedDetector::TrafficMirrorSet>();
-  for (auto tl_itr = all_lanelet_traffic_mirrors.begin(); tl_itr != all_lanelet_traffic_mirrors.end();
-       ++tl_itr) {
-    lanelet::AutowareTrafficMirrorConstPtr tl = *tl_itr;
-    // RegulatoryElement의 getParameters()를 통해 traffic_mirrors 접근
-    const auto & params = tl->getParameters();
-    auto traffic_mirrors_it = params.find("traffic_mirrors");
-    if (traffic_mirrors_it != params.end()) {
-      for (const auto & lsp : traffic_mirrors_it->second) {
-        if (const auto * ls = boost::get<lanelet::ConstLineString3d>(&lsp)) {
-          all_traffic_mirrors_ptr_->insert(*ls);
+    // the camera callbacks keep using the previous snapshot in the meantime, the new one starts
+    // as a copy of it since only this thread publishes snapshots
+    auto state = std::make_shared<DetectorState>(*std::atomic_load(&state_));
+    if (map_msg != nullptr) {
+      const auto start = std::chrono::steady_clock::now();
+      const auto elapsed = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      };
+      const bool use_cache = !config_.traffic_mirror_cache_dir.empty();
+      const uint64_t map_hash = use_cache ? hashMapPayload(map_msg->data) : 0;
+      const std::string cache_path =
+        use_cache ? makeTrafficMirrorCachePath(config_.traffic_mirror_cache_dir, map_hash) : "";
+      TrafficMirrorTable cached_table;
+      std::shared_ptr<const TrafficMirrorIndex> cached_traffic_mirrors;
+      if (use_cache && readTrafficMirrorCache(cache_path, map_hash, cached_table)) {
+        cached_traffic_mirrors = makeTrafficMirrorIndex(std::move(cached_table));
+        // serve the cached traffic mirrors while the map is being decoded. The route index
+        // belongs to the previous map and waits for the new one
+        auto cached_state = std::make_shared<DetectorState>(*state);
+        cached_state->all_traffic_mirrors = cached_traffic_mirrors;
+        cached_state->route_traffic_mirrors = nullptr;
+        cached_state->route_horizon = nullptr;
+        std::atomic_store(&state_, std::shared_ptr<const DetectorState>(std::move(cached_state)));
+        RCLCPP_INFO(
+          get_logger(), "traffic mirrors are loaded from the cache %s in %.3f s",
+          cache_path.c_str(), elapsed());
+      }
+
+      state->lanelet_map = loadMap(*map_msg);
+      if (cached_traffic_mirrors != nullptr) {
+        state->all_traffic_mirrors = cached_traffic_mirrors;
+      } else {
+        auto all_traffic_mirrors =
+          buildTrafficMirrorIndex(lanelet::utils::query::laneletLayer(state->lanelet_map));
+        if (
+          use_cache &&
+          !writeTrafficMirrorCache(cache_path, map_hash, all_traffic_mirrors->table)) {
+          RCLCPP_WARN(get_logger(), "cannot write the traffic mirror cache %s", cache_path.c_str());
         }
+        state->all_traffic_mirrors = all_traffic_mirrors;
       }
+      RCLCPP_INFO(
+        get_logger(), "map is loaded in %.3f s with %lu traffic mirrors", elapsed(),
+        state->all_traffic_mirrors->table.size());
     }
+    // a new map invalidates the route index, rebuild it from the last route
+    if (new_route_msg != nullptr) {
+      route_msg = new_route_msg;
+    }
+    if (map_msg != nullptr) {
+      // the traffic mirror indices of the new map differ, start over from an empty route
+      route_state_ = RouteState();
+      state->route_horizon = nullptr;
+    }
+    if (route_msg != nullptr && (map_msg != nullptr || new_route_msg != nullptr)) {
+      auto route_traffic_mirrors =
+        updateRouteTrafficMirrorIndex(*state, *route_msg, state->missing_route_primitive_num);
+      if (route_traffic_mirrors != nullptr) {
+        state->route_traffic_mirrors = route_traffic_mirrors;
+        state->route_horizon =
+          config_.route_horizon_mode ? buildRouteHorizon(*state, *route_msg) : nullptr;
+      }
+    }
+    std::atomic_store(&state_, std::shared_ptr<const DetectorState>(std::move(state)));
   }
 }
 
-void MapBasedDetector::routeCallback(
-  const autoware_planning_msgs::msg::LaneletRoute::ConstSharedPtr input_msg)
+lanelet::LaneletMapConstPtr MapBasedDetector::loadMap(
+  const autoware_auto_mapping_msgs::msg::HADMapBin & map_msg) const
+{
+  auto lanelet_map_ptr = std::make_shared<lanelet::LaneletMap>();
+  lanelet::utils::conversion::fromBinMsg(map_msg, lanelet_map_ptr);
+  return lanelet_map_ptr;
+}
+
+std::shared_ptr<MapBasedDetector::TrafficMirrorIndex>
+MapBasedDetector::updateRouteTrafficMirrorIndex(
+  const DetectorState & state, const autoware_planning_msgs::msg::LaneletRoute & route_msg,
+  size_t & missing_primitive_num)
 {
-  if (lanelet_map_ptr_ == nullptr) {
+  missing_primitive_num = 0;
+  if (state.lanelet_map == nullptr || state.all_traffic_mirrors == nullptr) {
     RCLCPP_WARN(get_logger(), "cannot set traffic mirror in route because don't receive map");
-    return;
+    return nullptr;
   }
-  lanelet::ConstLanelets route_lanelets;
-  for (const auto & segment : input_msg->segments) {
-    for (const auto & primitive : segment.primitives) {
-      try {
-        route_lanelets.push_back(lanelet_map_ptr_->laneletLayer.get(primitive.id));
-      } catch (const lanelet::NoSuchPrimitiveError & ex) {
-        RCLCPP_ERROR(get_logger(), "%s", ex.what());
-        return;
+  const auto start = std::chrono::steady_clock::now();
+  std::unordered_set<lanelet::Id> lanelet_ids;
+  if (!getRouteLaneletIds(
+        *state.lanelet_map, route_msg, config_.skip_unknown_route_primitives, get_logger(),
+        lanelet_ids, missing_primitive_num)) {
+    return nullptr;
+  }
+
+  // apply the difference to the previous route
+  const auto & lanelet_traffic_mirrors = state.all_traffic_mirrors->lanelet_traffic_mirrors;
+  auto & ref_counts = route_state_.traffic_mirror_ref_counts;
+  size_t added_lanelet_num = 0;
+  size_t removed_lanelet_num = 0;
+  for (const lanelet::Id id : route_state_.lanelet_ids) {
+    if (lanelet_ids.count(id) > 0) {
+      continue;
+    }
+    ++removed_lanelet_num;
+    const auto it = lanelet_traffic_mirrors.find(id);
+    if (it == lanelet_traffic_mirrors.end()) {
+      continue;
+    }
+    for (const size_t traffic_mirror : it->second) {
+      const auto ref_count = ref_counts.find(traffic_mirror);
+      if (ref_count != ref_counts.end() && --ref_count->second == 0) {
+        ref_counts.erase(ref_count);
       }
     }
   }
-  std::vector<lanelet::AutowareTrafficMirrorConstPtr> route_lanelet_traffic_mirrors =
-    lanelet::utils::query::autowareTrafficMirrors(route_lanelets);
-  route_traffic_mirrors_ptr_ = std::make_shared<MapBasedDetector::TrafficMirrorSet>();
-  for (auto tl_itr = route_lanelet_traffic_mirrors.begin();
-       tl_itr != route_lanelet_traffic_mirrors.end(); ++tl_itr) {
-    lanelet::AutowareTrafficMirrorConstPtr tl = *tl_itr;
-    // RegulatoryElement의 getParameters()를 통해 traffic_mirrors 접근
-    const auto & params = tl->getParameters();
-    auto traffic_mirrors_it = params.find("traffic_mirrors");
-    if (traffic_mirrors_it != params.end()) {
-      for (const auto & lsp : traffic_mirrors_it->second) {
-        if (const auto * ls = boost::get<lanelet::ConstLineString3d>(&lsp)) {
-          route_traffic_mirrors_ptr_->insert(*ls);
-        }
-      }
+  for (const lanelet::Id id : lanelet_ids) {
+    if (route_state_.lanelet_ids.count(id) > 0) {
+      continue;
+    }
+    ++added_lanelet_num;
+    const auto it = lanelet_traffic_mirrors.find(id);
+    if (it == lanelet_traffic_mirrors.end()) {
+      continue;
+    }
+    for (const size_t traffic_mirror : it->second) {
+      ++ref_counts[traffic_mirror];
     }
   }
+  route_state_.lanelet_ids = std::move(lanelet_ids);
+
+  // keep the id order of the table of all the traffic mirrors
+  std::vector<size_t> route_traffic_mirrors;
+  route_traffic_mirrors.reserve(ref_counts.size());
+  for (const auto & [traffic_mirror, ref_count] : ref_counts) {
+    route_traffic_mirrors.push_back(traffic_mirror);
+  }
+  std::sort(route_traffic_mirrors.begin(), route_traffic_mirrors.end());
+  auto index =
+    makeTrafficMirrorIndex(state.all_traffic_mirrors->table.select(route_traffic_mirrors));
+  const double elapsed =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  RCLCPP_INFO(
+    get_logger(),
+    "route is updated in %.3f ms (lanelets added: %lu, removed: %lu, traffic mirrors: %lu)",
+    elapsed * 1e3, added_lanelet_num, removed_lanelet_num, index->table.size());
+  return index;
 }
 
-void MapBasedDetector::getVisibleTrafficMirrors(
-  const MapBasedDetector::TrafficMirrorSet & all_traffic_mirrors,
-  const std::vector<tf2::Transform> & tf_map2camera_vec,
-  const image_geometry::PinholeCameraModel & pinhole_camera_model,
-  std::vector<lanelet::ConstLineString3d> & visible_traffic_mirrors) const
+std::shared_ptr<const RouteHorizon> MapBasedDetector::buildRouteHorizon(
+  const DetectorState & state, const autoware_planning_msgs::msg::LaneletRoute & route_msg) const
 {
-  for (const auto & traffic_mirror : all_traffic_mirrors) {
-    // some "Traffic Mirror" are actually not traffic mirrors
-    if (
-      traffic_mirror.hasAttribute("subtype") == false ||
-      traffic_mirror.attribute("subtype").value() == "solid") {
-      continue;
-    }
-    // traffic mirror bottom left
-    const auto & tl_bl = traffic_mirror.front();
-    // traffic mirror bottom right
-    const auto & tl_br = traffic_mirror.back();
-    // check distance range
-    tf2::Vector3 tl_center = getTrafficMirrorCenter(traffic_mirror);
-    // for every possible transformation, check if the tl is visible.
-    // If under any tf the tl is visible, keep it
-    for (const auto & tf_map2camera : tf_map2camera_vec) {
-      if (!isInDistanceRange(tl_center, tf_map2camera.getOrigin(), config_.max_detection_range)) {
-        continue;
+  const TrafficMirrorIndex & route_traffic_mirrors = *state.route_traffic_mirrors;
+  std::vector<RouteHorizon::Polyline> centerlines;
+  std::vector<std::vector<size_t>> segment_traffic_mirrors;
+  for (const auto & segment : route_msg.segments) {
+    lanelet::Id preferred_id = segment.preferred_primitive.id;
+    if (!state.lanelet_map->laneletLayer.exists(preferred_id)) {
+      if (!config_.skip_unknown_route_primitives) {
+        RCLCPP_ERROR(
+          get_logger(), "preferred lanelet %ld of the route is not in the map", preferred_id);
+        return nullptr;
       }
-
-      // check angle range
-      const double tl_yaw = tier4_autoware_utils::normalizeRadian(
-        std::atan2(tl_br.y() - tl_bl.y(), tl_br.x() - tl_bl.x()) + M_PI_2);
-      constexpr double max_angle_range = tier4_autoware_utils::deg2rad(40.0);
-
-      // get direction of z axis
-      tf2::Vector3 camera_z_dir(0, 0, 1);
-      tf2::Matrix3x3 camera_rotation_matrix(tf_map2camera.getRotation());
-      camera_z_dir = camera_rotation_matrix * camera_z_dir;
-      double camera_yaw = std::atan2(camera_z_dir.y(), camera_z_dir.x());
-      camera_yaw = tier4_autoware_utils::normalizeRadian(camera_yaw);
-      if (!isInAngleRange(tl_yaw, camera_yaw, max_angle_range)) {
+      // any lanelet of the segment runs along the same stretch of the route
+      const auto known_primitive = std::find_if(
+        segment.primitives.begin(), segment.primitives.end(), [&state](const auto & primitive) {
+          return state.lanelet_map->laneletLayer.exists(primitive.id);
+        });
+      if (known_primitive == segment.primitives.end()) {
         continue;
       }
-
-      // check within image frame
-      tf2::Vector3 tf_camera2tltl = tf_map2camera.inverse() * getTrafficMirrorTopLeft(traffic_mirror);
-      tf2::Vector3 tf_camera2tlbr =
-        tf_map2camera.inverse() * getTrafficMirrorBottomRight(traffic_mirror);
-      if (
-        !isInImageFrame(pinhole_camera_model, tf_camera2tltl) &&
-        !isInImageFrame(pinhole_camera_model, tf_camera2tlbr)) {
-        continue;
+      preferred_id = known_primitive->id;
+    }
+    RouteHorizon::Polyline centerline;
+    for (const auto & point : state.lanelet_map->laneletLayer.get(preferred_id).centerline2d()) {
+      centerline.emplace_back(point.x(), point.y());
+    }
+    centerlines.push_back(std::move(centerline));
+    // the traffic mirrors of the neighbor lanelets are on the same stretch of the route
+    std::vector<size_t> traffic_mirrors;
+    for (const auto & primitive : segment.primitives) {
+      const auto it = route_traffic_mirrors.lanelet_traffic_mirrors.find(primitive.id);
+      if (it != route_traffic_mirrors.lanelet_traffic_mirrors.end()) {
+        traffic_mirrors.insert(traffic_mirrors.end(), it->second.begin(), it->second.end());
       }
-      visible_traffic_mirrors.push_back(traffic_mirror);
-      break;
     }
+    std::sort(traffic_mirrors.begin(), traffic_mirrors.end());
+    traffic_mirrors.erase(
+      std::unique(traffic_mirrors.begin(), traffic_mirrors.end()), traffic_mirrors.end());
+    segment_traffic_mirrors.push_back(std::move(traffic_mirrors));
   }
+  return std::make_shared<const RouteHorizon>(
+    centerlines, segment_traffic_mirrors, route_traffic_mirrors.table.center_x,
+    route_traffic_mirrors.table.center_y);
+}
+
+std::shared_ptr<MapBasedDetector::TrafficMirrorIndex> MapBasedDetector::buildTrafficMirrorIndex(
+  const lanelet::ConstLanelets & lanelets) const
+{
+  return makeTrafficMirrorIndex(buildTrafficMirrorTable(lanelets));
+}
+
+std::shared_ptr<MapBasedDetector::TrafficMirrorIndex> MapBasedDetector::makeTrafficMirrorIndex(
+  TrafficMirrorTable table) const
+{
+  auto index = std::make_shared<MapBasedDetector::TrafficMirrorIndex>();
+  index->table = std::move(table);
+  // with cells as large as the detection range a query touches about 3x3 cells
+  index->grid = SpatialGrid(
+    index->table.center_x, index->table.center_y, config_.detection.max_detection_range);
+  const TrafficMirrorTable & indexed_table = index->table;
+  for (size_t i = 0; i < indexed_table.size(); ++i) {
+    for (uint64_t j = indexed_table.lanelet_offsets[i]; j < indexed_table.lanelet_offsets[i + 1];
+         ++j) {
+      index->lanelet_traffic_mirrors[indexed_table.lanelet_ids[j]].push_back(i);
+    }
+  }
+  return index;
 }
 
 void MapBasedDetector::publishVisibleTrafficMirrors(
-  const tf2::Transform & tf_map2camera, const std_msgs::msg::Header & cam_info_header,
-  const std::vector<lanelet::ConstLineString3d> & visible_traffic_mirrors,
+  const CameraPose & camera_pose, const std_msgs::msg::Header & cam_info_header,
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & visible_traffic_mirrors,
   const rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr pub)
 {
-  visualization_msgs::msg::MarkerArray output_msg;
-  for (const auto & traffic_mirror : visible_traffic_mirrors) {
-    const int id = traffic_mirror.id();
-    tf2::Vector3 tl_central_point = getTrafficMirrorCenter(traffic_mirror);
-    tf2::Vector3 camera2tl = tf_map2camera.inverse() * tl_central_point;
-
-    visualization_msgs::msg::Marker marker;
-    marker.header = cam_info_header;
-    marker.id = id;
-    marker.type = visualization_msgs::msg::Marker::LINE_LIST;
-    marker.ns = std::string("beam");
-    marker.scale.x = 0.05;
-    marker.action = visualization_msgs::msg::Marker::MODIFY;
-    marker.pose.position.x = 0.0;
-    marker.pose.position.y = 0.0;
-    marker.pose.position.z = 0.0;
-    marker.pose.orientation.x = 0.0;
-    marker.pose.orientation.y = 0.0;
-    marker.pose.orientation.z = 0.0;
-    marker.pose.orientation.w = 1.0;
-    geometry_msgs::msg::Point point;
-    point.x = 0.0;
-    point.y = 0.0;
-    point.z = 0.0;
-    marker.points.push_back(point);
-    point.x = camera2tl.x();
-    point.y = camera2tl.y();
-    point.z = camera2tl.z();
-    marker.points.push_back(point);
-
-    marker.lifetime = rclcpp::Duration::from_seconds(0.2);
-    marker.color.a = 0.999;  // Don't forget to set the alpha!
-    marker.color.r = 0.0;
-    marker.color.g = 1.0;
-    marker.color.b = 0.0;
-
-    output_msg.markers.push_back(marker);
-  }
-  pub->publish(output_msg);
+  pub->publish(makeVisibleTrafficMirrorMarkers(
+    camera_pose, cam_info_header, traffic_mirrors, visible_traffic_mirrors));
+}
+
+void MapBasedDetector::publishMetrics(CameraContext & camera)
+{
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.name = std::string(get_name()) + ": " + (camera.name.empty() ? "camera" : camera.name);
+  status.hardware_id = camera.name;
+  const auto add_value = [&status](const std::string & key, const std::string & value) {
+    diagnostic_msgs::msg::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = value;
+    status.values.push_back(key_value);
+  };
+  add_value("deferred_frames_total", std::to_string(camera.deferred_frame_count));
+  add_value("dropped_frames_total", std::to_string(camera.dropped_frame_count));
+  add_value(
+    "missing_route_primitives",
+    std::to_string(std::atomic_load(&state_)->missing_route_primitive_num));
+
+#ifdef TRAFFIC_MIRROR_ENABLE_STAGE_METRICS
+  const auto to_ms = [](const uint64_t ns) {
+    return std::to_string(static_cast<double>(ns) * 1e-6);
+  };
+  const auto add_latency = [&add_value, &to_ms](
+                             const std::string & stage, const LatencyHistogram & histogram) {
+    add_value(stage + ".p50_ms", to_ms(histogram.percentile(0.5)));
+    add_value(stage + ".p99_ms", to_ms(histogram.percentile(0.99)));
+    add_value(stage + ".max_ms", to_ms(histogram.max()));
+  };
+
+  StageMetrics & metrics = camera.metrics;
+  add_value("frames", std::to_string(metrics.frame_count));
+  add_latency("tf_lookup", metrics.tf_lookup);
+  add_latency("culling", metrics.culling);
+  add_latency("roi_projection", metrics.roi_projection);
+  add_latency("publish", metrics.publish);
+  add_latency("markers", metrics.markers);
+  add_latency("total", metrics.total);
+  // the counts are averaged over the frames of the period
+  const double frame_num = static_cast<double>(std::max<uint64_t>(metrics.frame_count, 1));
+  add_value("candidates_per_frame", std::to_string(metrics.candidate_count / frame_num));
+  add_value("visible_per_frame", std::to_string(metrics.visible_count / frame_num));
+  add_value("rois_per_frame", std::to_string(metrics.roi_count / frame_num));
+  metrics.reset();
+#endif
+
+  diagnostic_msgs::msg::DiagnosticArray output_msg;
+  output_msg.header.stamp = now();
+  output_msg.status.push_back(status);
+  camera.metrics_pub->publish(output_msg);
 }
 }  // namespace traffic_mirror
 
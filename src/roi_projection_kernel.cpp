@@ -0,0 +1,118 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/roi_projection_kernel.hpp"
+
+#include <cmath>
+
+namespace traffic_mirror
+{
+void RoiProjectionKernel::setTrafficMirrors(
+  const TrafficMirrorTable & traffic_mirrors, const std::vector<size_t> & indices)
+{
+  const size_t n = indices.size();
+  top_left_x_.resize(n);
+  top_left_y_.resize(n);
+  top_left_z_.resize(n);
+  bottom_right_x_.resize(n);
+  bottom_right_y_.resize(n);
+  bottom_right_z_.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    const size_t idx = indices[i];
+    top_left_x_[i] = traffic_mirrors.top_left_x[idx];
+    top_left_y_[i] = traffic_mirrors.top_left_y[idx];
+    top_left_z_[i] = traffic_mirrors.top_left_z[idx];
+    bottom_right_x_[i] = traffic_mirrors.bottom_right_x[idx];
+    bottom_right_y_[i] = traffic_mirrors.bottom_right_y[idx];
+    bottom_right_z_[i] = traffic_mirrors.bottom_right_z[idx];
+  }
+  camera_x_.resize(n);
+  camera_y_.resize(n);
+  camera_z_.resize(n);
+}
+
+void RoiProjectionKernel::transformAndEnlarge(
+  const std::vector<double> & xs, const std::vector<double> & ys, const std::vector<double> & zs,
+  const RigidTransform & tf_camera2map, const VibrationBound & vibration, const double sign)
+{
+  // local copies, so that the compiler knows they do not alias the outputs
+  const auto & r = tf_camera2map.rotation;
+  const auto & t = tf_camera2map.translation;
+  const double r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4], r5 = r[5];
+  const double r6 = r[6], r7 = r[7], r8 = r[8], t0 = t[0], t1 = t[1], t2 = t[2];
+  const double sin_yaw = std::sin(vibration.max_vibration_yaw * 0.5);
+  const double sin_pitch = std::sin(vibration.max_vibration_pitch * 0.5);
+  const double half_width = vibration.max_vibration_width * 0.5;
+  const double half_height = vibration.max_vibration_height * 0.5;
+  const double half_depth = vibration.max_vibration_depth * 0.5;
+
+  const size_t n = xs.size();
+  const double * __restrict x = xs.data();
+  const double * __restrict y = ys.data();
+  const double * __restrict z = zs.data();
+  double * __restrict cx = camera_x_.data();
+  double * __restrict cy = camera_y_.data();
+  double * __restrict cz = camera_z_.data();
+  // The arrays never overlap. Without the simd pragmas GCC only vectorizes these loops at -O3,
+  // behind runtime aliasing checks; -O2 keeps them scalar. The depth goes first since the angular
+  // vibration grows with it
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    cz[i] = r6 * x[i] + r7 * y[i] + r8 * z[i] + t2;
+  }
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    const double max_vibration_x = sin_yaw * cz[i] + half_width;
+    cx[i] = r0 * x[i] + r1 * y[i] + r2 * z[i] + t0 + sign * max_vibration_x;
+  }
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    const double max_vibration_y = sin_pitch * cz[i] + half_height;
+    cy[i] = r3 * x[i] + r4 * y[i] + r5 * z[i] + t1 + sign * max_vibration_y;
+  }
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    cz[i] -= half_depth;
+  }
+}
+
+void RoiProjectionKernel::project(
+  const RigidTransform & tf_camera2map, const VibrationBound & vibration,
+  const CameraProjector & projector, RoiCorners & corners)
+{
+  const size_t n = size();
+  corners.top_left_u.resize(n);
+  corners.top_left_v.resize(n);
+  corners.bottom_right_u.resize(n);
+  corners.bottom_right_v.resize(n);
+  corners.is_valid.resize(n);
+
+  transformAndEnlarge(top_left_x_, top_left_y_, top_left_z_, tf_camera2map, vibration, -1.0);
+  for (size_t i = 0; i < n; ++i) {
+    corners.is_valid[i] = camera_z_[i] > 0.0 ? 1 : 0;
+  }
+  projector.projectToRaw(
+    camera_x_.data(), camera_y_.data(), camera_z_.data(), n, corners.top_left_u.data(),
+    corners.top_left_v.data());
+
+  transformAndEnlarge(
+    bottom_right_x_, bottom_right_y_, bottom_right_z_, tf_camera2map, vibration, 1.0);
+  for (size_t i = 0; i < n; ++i) {
+    corners.is_valid[i] &= camera_z_[i] > 0.0 ? 1 : 0;
+  }
+  projector.projectToRaw(
+    camera_x_.data(), camera_y_.data(), camera_z_.data(), n, corners.bottom_right_u.data(),
+    corners.bottom_right_v.data());
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,174 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/route_horizon.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// the camera moves much less than this between two frames
+constexpr double search_range = 100.0;
+// farther from the centerlines around the hint, the camera is searched on the whole route
+constexpr double max_lateral_distance = 10.0;
+}  // namespace
+
+namespace traffic_mirror
+{
+RouteHorizon::RouteHorizon(
+  const std::vector<Polyline> & centerlines,
+  const std::vector<std::vector<size_t>> & segment_traffic_mirrors,
+  const std::vector<double> & center_x, const std::vector<double> & center_y)
+{
+  // the arc length continues from one segment to the next, a lane change adds no length
+  double s = 0.0;
+  std::vector<size_t> segment_offsets{0};
+  for (const auto & centerline : centerlines) {
+    for (size_t i = 0; i < centerline.size(); ++i) {
+      if (i > 0) {
+        s += std::hypot(
+          centerline[i].first - centerline[i - 1].first,
+          centerline[i].second - centerline[i - 1].second);
+      }
+      point_x_.push_back(centerline[i].first);
+      point_y_.push_back(centerline[i].second);
+      point_s_.push_back(s);
+      has_edge_.push_back(i + 1 < centerline.size() ? 1 : 0);
+    }
+    segment_offsets.push_back(point_x_.size());
+  }
+
+  // a traffic mirror is placed at its projection on the centerline of the segment referring to it
+  std::vector<std::pair<double, size_t>> entries;
+  for (size_t segment = 0; segment < segment_traffic_mirrors.size(); ++segment) {
+    if (segment + 1 >= segment_offsets.size()) {
+      break;
+    }
+    const size_t first_point = segment_offsets[segment];
+    const size_t last_point = segment_offsets[segment + 1];
+    if (first_point == last_point) {
+      continue;
+    }
+    for (const size_t traffic_mirror : segment_traffic_mirrors[segment]) {
+      const double entry_s =
+        findClosest(center_x[traffic_mirror], center_y[traffic_mirror], first_point, last_point)
+          .second;
+      entries.emplace_back(entry_s, traffic_mirror);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  entry_s_.reserve(entries.size());
+  entry_traffic_mirrors_.reserve(entries.size());
+  for (const auto & [entry_s, traffic_mirror] : entries) {
+    entry_s_.push_back(entry_s);
+    entry_traffic_mirrors_.push_back(traffic_mirror);
+  }
+}
+
+std::pair<double, double> RouteHorizon::findClosest(
+  const double x, const double y, const size_t first_point, const size_t last_point) const
+{
+  double min_sq_dist = std::numeric_limits<double>::max();
+  double closest_s = 0.0;
+  for (size_t i = first_point; i < last_point; ++i) {
+    double px = point_x_[i];
+    double py = point_y_[i];
+    double ps = point_s_[i];
+    if (has_edge_[i] && i + 1 < point_x_.size()) {
+      const double ex = point_x_[i + 1] - px;
+      const double ey = point_y_[i + 1] - py;
+      const double sq_len = ex * ex + ey * ey;
+      if (sq_len > 0.0) {
+        const double t = std::clamp(((x - px) * ex + (y - py) * ey) / sq_len, 0.0, 1.0);
+        px += t * ex;
+        py += t * ey;
+        ps += t * (point_s_[i + 1] - point_s_[i]);
+      }
+    }
+    const double sq_dist = (x - px) * (x - px) + (y - py) * (y - py);
+    if (sq_dist < min_sq_dist) {
+      min_sq_dist = sq_dist;
+      closest_s = ps;
+    }
+  }
+  return {min_sq_dist, closest_s};
+}
+
+double RouteHorizon::locate(
+  const double x, const double y, const double hint, const bool has_hint) const
+{
+  if (point_x_.empty()) {
+    return 0.0;
+  }
+  if (has_hint) {
+    size_t first_point =
+      std::lower_bound(point_s_.begin(), point_s_.end(), hint - search_range) - point_s_.begin();
+    // the edge ending at the first point in range is also in range
+    first_point = first_point > 0 ? first_point - 1 : 0;
+    const size_t last_point =
+      std::upper_bound(point_s_.begin(), point_s_.end(), hint + search_range) - point_s_.begin();
+    const auto [sq_dist, s] = findClosest(x, y, first_point, last_point);
+    if (sq_dist <= max_lateral_distance * max_lateral_distance) {
+      return s;
+    }
+  }
+  return findClosest(x, y, 0, point_x_.size()).second;
+}
+
+void RouteHorizonTracker::update(
+  const std::shared_ptr<const RouteHorizon> & horizon, const double x, const double y,
+  const double ahead, const double behind, std::vector<size_t> & traffic_mirrors)
+{
+  if (horizon != horizon_) {
+    horizon_ = horizon;
+    has_arc_length_ = false;
+    begin_ = 0;
+    end_ = 0;
+  }
+  if (horizon_ == nullptr) {
+    return;
+  }
+  arc_length_ = horizon_->locate(x, y, arc_length_, has_arc_length_);
+  has_arc_length_ = true;
+
+  // move both ends of the window from where they were in the previous frame
+  const double lower = arc_length_ - behind;
+  const double upper = arc_length_ + ahead;
+  const size_t n = horizon_->size();
+  while (begin_ < n && horizon_->entryArcLength(begin_) < lower) {
+    ++begin_;
+  }
+  while (begin_ > 0 && horizon_->entryArcLength(begin_ - 1) >= lower) {
+    --begin_;
+  }
+  end_ = std::max(end_, begin_);
+  while (end_ < n && horizon_->entryArcLength(end_) <= upper) {
+    ++end_;
+  }
+  while (end_ > begin_ && horizon_->entryArcLength(end_ - 1) > upper) {
+    --end_;
+  }
+
+  const size_t first_new = traffic_mirrors.size();
+  for (size_t entry = begin_; entry < end_; ++entry) {
+    traffic_mirrors.push_back(horizon_->entryTrafficMirror(entry));
+  }
+  std::sort(traffic_mirrors.begin() + first_new, traffic_mirrors.end());
+  traffic_mirrors.erase(
+    std::unique(traffic_mirrors.begin() + first_new, traffic_mirrors.end()),
+    traffic_mirrors.end());
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,94 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/spatial_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// keep the dense cell table small even for huge, sparse maps
+constexpr size_t max_cell_num = 1 << 20;
+}  // namespace
+
+namespace traffic_mirror
+{
+SpatialGrid::SpatialGrid(
+  const std::vector<double> & xs, const std::vector<double> & ys, double cell_size)
+{
+  if (xs.empty() || xs.size() != ys.size()) {
+    return;
+  }
+  const auto [min_x, max_x] = std::minmax_element(xs.begin(), xs.end());
+  const auto [min_y, max_y] = std::minmax_element(ys.begin(), ys.end());
+  origin_x_ = *min_x;
+  origin_y_ = *min_y;
+  cell_size_ = std::max(cell_size, 1.0);
+  while (true) {
+    cols_ = static_cast<size_t>((*max_x - origin_x_) / cell_size_) + 1;
+    rows_ = static_cast<size_t>((*max_y - origin_y_) / cell_size_) + 1;
+    if (cols_ * rows_ <= max_cell_num) {
+      break;
+    }
+    cell_size_ *= 2.0;
+  }
+
+  // counting sort of the points by cell
+  std::vector<size_t> point_cells(xs.size());
+  cell_offsets_.assign(cols_ * rows_ + 1, 0);
+  for (size_t i = 0; i < xs.size(); ++i) {
+    const auto col = static_cast<size_t>((xs[i] - origin_x_) / cell_size_);
+    const auto row = static_cast<size_t>((ys[i] - origin_y_) / cell_size_);
+    point_cells[i] = cellIndex(col, row);
+    ++cell_offsets_[point_cells[i] + 1];
+  }
+  for (size_t c = 1; c < cell_offsets_.size(); ++c) {
+    cell_offsets_[c] += cell_offsets_[c - 1];
+  }
+  items_.resize(xs.size());
+  std::vector<size_t> fill(cell_offsets_.begin(), cell_offsets_.end() - 1);
+  for (size_t i = 0; i < xs.size(); ++i) {
+    items_[fill[point_cells[i]]++] = i;
+  }
+}
+
+void SpatialGrid::query(
+  const double min_x, const double min_y, const double max_x, const double max_y,
+  std::vector<size_t> & indices) const
+{
+  if (items_.empty()) {
+    return;
+  }
+  const double col_begin = std::floor((min_x - origin_x_) / cell_size_);
+  const double col_end = std::floor((max_x - origin_x_) / cell_size_);
+  const double row_begin = std::floor((min_y - origin_y_) / cell_size_);
+  const double row_end = std::floor((max_y - origin_y_) / cell_size_);
+  if (
+    col_end < 0.0 || row_end < 0.0 || col_begin >= static_cast<double>(cols_) ||
+    row_begin >= static_cast<double>(rows_)) {
+    return;
+  }
+  const auto c0 = static_cast<size_t>(std::max(col_begin, 0.0));
+  const auto c1 = std::min(static_cast<size_t>(col_end), cols_ - 1);
+  const auto r0 = static_cast<size_t>(std::max(row_begin, 0.0));
+  const auto r1 = std::min(static_cast<size_t>(row_end), rows_ - 1);
+  for (size_t row = r0; row <= r1; ++row) {
+    // cells of one row are adjacent, so the whole column span is one contiguous item range
+    const size_t first = cell_offsets_[cellIndex(c0, row)];
+    const size_t last = cell_offsets_[cellIndex(c1, row) + 1];
+    indices.insert(indices.end(), items_.begin() + first, items_.begin() + last);
+  }
+}
+}  // namespace traffic_mirror
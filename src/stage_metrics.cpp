@@ -0,0 +1,71 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/stage_metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace traffic_mirror
+{
+uint64_t LatencyHistogram::bucketUpperValue(const size_t bucket)
+{
+  if (bucket < 2 * sub_bucket_half_count) {
+    return bucket;
+  }
+  const size_t shift = bucket / sub_bucket_half_count - 1;
+  const uint64_t mantissa = bucket - shift * sub_bucket_half_count;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(const double ratio) const
+{
+  if (total_count_ == 0) {
+    return 0;
+  }
+  const double clamped_ratio = std::clamp(ratio, 0.0, 1.0);
+  const uint64_t rank = std::max<uint64_t>(
+    1, static_cast<uint64_t>(std::ceil(clamped_ratio * static_cast<double>(total_count_))));
+  uint64_t cumulative_count = 0;
+  for (size_t bucket = 0; bucket < bucket_num; ++bucket) {
+    cumulative_count += counts_[bucket];
+    if (cumulative_count >= rank) {
+      // the bucket may reach beyond the largest recorded value
+      return std::min(bucketUpperValue(bucket), max_);
+    }
+  }
+  return max_;
+}
+
+void LatencyHistogram::reset()
+{
+  counts_.fill(0);
+  total_count_ = 0;
+  max_ = 0;
+}
+
+void StageMetrics::reset()
+{
+  tf_lookup.reset();
+  culling.reset();
+  roi_projection.reset();
+  publish.reset();
+  markers.reset();
+  total.reset();
+  frame_count = 0;
+  candidate_count = 0;
+  visible_count = 0;
+  roi_count = 0;
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,290 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/synthetic_map.hpp"
+
+#include <lanelet2_extension/regulatory_elements/autoware_traffic_mirror.hpp>
+#include <lanelet2_extension/utility/message_conversion.hpp>
+
+#include <Eigen/Core>
+#include <lanelet2_core/primitives/Lanelet.h>
+#include <lanelet2_core/primitives/LineString.h>
+#include <lanelet2_core/primitives/RegulatoryElement.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace
+{
+enum class Heading { East, West, North, South };
+
+/**
+ * @brief side of an intersection the points of the lane bounds are placed at
+ *
+ */
+enum class Side { Center, South, North, East, West };
+
+class SyntheticMapBuilder
+{
+public:
+  explicit SyntheticMapBuilder(const traffic_mirror::SyntheticMapConfig & config)
+  : config_(config), rng_(config.seed)
+  {
+  }
+
+  traffic_mirror::SyntheticMap build()
+  {
+    map_.lanelet_map = std::make_shared<lanelet::LaneletMap>();
+    const size_t cols = config_.grid_cols;
+    const size_t rows = config_.grid_rows;
+    if (cols == 0 || rows == 0) {
+      return std::move(map_);
+    }
+    // lanelet ids by heading, [row][col] of the intersection the lanelet starts from when driving
+    // east or north, and of the one it ends at when driving west or south
+    std::map<std::tuple<Heading, size_t, size_t>, lanelet::Id> lanelet_ids;
+    for (size_t row = 0; row < rows; ++row) {
+      for (size_t col = 0; col + 1 < cols; ++col) {
+        const lanelet::LineString3d center = makeLineString(
+          {getPoint(col, row, Side::Center), getPoint(col + 1, row, Side::Center)}, "dashed");
+        lanelet_ids[{Heading::East, row, col}] = addLanelet(
+          center,
+          makeLineString({getPoint(col, row, Side::South), getPoint(col + 1, row, Side::South)}),
+          Eigen::Vector2d::UnitX());
+        lanelet_ids[{Heading::West, row, col}] = addLanelet(
+          center.invert(),
+          makeLineString({getPoint(col + 1, row, Side::North), getPoint(col, row, Side::North)}),
+          -Eigen::Vector2d::UnitX());
+      }
+    }
+    for (size_t col = 0; col < cols; ++col) {
+      for (size_t row = 0; row + 1 < rows; ++row) {
+        const lanelet::LineString3d center = makeLineString(
+          {getPoint(col, row, Side::Center), getPoint(col, row + 1, Side::Center)}, "dashed");
+        lanelet_ids[{Heading::North, row, col}] = addLanelet(
+          center,
+          makeLineString({getPoint(col, row, Side::East), getPoint(col, row + 1, Side::East)}),
+          Eigen::Vector2d::UnitY());
+        lanelet_ids[{Heading::South, row, col}] = addLanelet(
+          center.invert(),
+          makeLineString({getPoint(col, row + 1, Side::West), getPoint(col, row, Side::West)}),
+          -Eigen::Vector2d::UnitY());
+      }
+    }
+
+    // the route drives east along even rows and west along odd ones, turning north at the ends
+    for (size_t row = 0; row < rows && map_.route_lanelet_ids.size() < config_.route_lanelet_num;
+         ++row) {
+      const bool is_eastbound = row % 2 == 0;
+      for (size_t i = 0; i + 1 < cols; ++i) {
+        const size_t col = is_eastbound ? i : cols - 2 - i;
+        addRouteLanelet(lanelet_ids.at({is_eastbound ? Heading::East : Heading::West, row, col}));
+      }
+      if (row + 1 < rows) {
+        addRouteLanelet(lanelet_ids.at({Heading::North, row, is_eastbound ? cols - 1 : 0}));
+      }
+    }
+    return std::move(map_);
+  }
+
+private:
+  lanelet::Point3d getPoint(const size_t col, const size_t row, const Side side)
+  {
+    const auto key = std::make_tuple(col, row, side);
+    const auto it = points_.find(key);
+    if (it != points_.end()) {
+      return it->second;
+    }
+    double x = static_cast<double>(col) * config_.block_length;
+    double y = static_cast<double>(row) * config_.block_length;
+    switch (side) {
+      case Side::Center:
+        break;
+      case Side::South:
+        y -= config_.lane_width;
+        break;
+      case Side::North:
+        y += config_.lane_width;
+        break;
+      case Side::East:
+        x += config_.lane_width;
+        break;
+      case Side::West:
+        x -= config_.lane_width;
+        break;
+    }
+    const lanelet::Point3d point(next_id_++, x, y, 0.0);
+    points_.emplace(key, point);
+    return point;
+  }
+
+  lanelet::LineString3d makeLineString(
+    const lanelet::Points3d & points, const std::string & subtype = "solid")
+  {
+    lanelet::LineString3d line_string(next_id_++, points);
+    line_string.attributes()[lanelet::AttributeName::Type] =
+      lanelet::AttributeValueString::LineThin;
+    line_string.attributes()[lanelet::AttributeName::Subtype] = subtype;
+    return line_string;
+  }
+
+  /**
+   * @brief Add a lanelet driving along direction, and the traffic mirrors to its right
+   *
+   */
+  lanelet::Id addLanelet(
+    const lanelet::LineString3d & left, const lanelet::LineString3d & right,
+    const Eigen::Vector2d & direction)
+  {
+    lanelet::Lanelet lanelet(next_id_++, left, right);
+    lanelet.attributes()[lanelet::AttributeName::Subtype] = lanelet::AttributeValueString::Road;
+    lanelet.attributes()[lanelet::AttributeName::Location] = lanelet::AttributeValueString::Urban;
+    lanelet.attributes()[lanelet::AttributeName::OneWay] = "yes";
+
+    const size_t traffic_mirror_num = drawTrafficMirrorNum();
+    // unit vector to the left of the lanelet
+    const Eigen::Vector2d left_normal(-direction.y(), direction.x());
+    const Eigen::Vector2d start(left.front().x(), left.front().y());
+    std::uniform_real_distribution<double> arc_ratio(0.2, 0.8);
+    std::uniform_real_distribution<double> mount_height(
+      config_.min_mount_height, config_.max_mount_height);
+    std::uniform_real_distribution<double> height(config_.min_height, config_.max_height);
+    for (size_t i = 0; i < traffic_mirror_num; ++i) {
+      // one meter beyond the right bound, facing the vehicles driving on the lanelet. The node
+      // takes the facing direction 90 degrees to the left of the line string and sees a traffic
+      // mirror facing along the camera, so the line string runs to the right of the lanelet
+      const Eigen::Vector2d center = start + arc_ratio(rng_) * config_.block_length * direction -
+                                     (config_.lane_width + 1.0) * left_normal;
+      const Eigen::Vector2d half_width = 0.5 * config_.traffic_mirror_width * left_normal;
+      const double z = mount_height(rng_);
+      const lanelet::Point3d front(
+        next_id_++, center.x() + half_width.x(), center.y() + half_width.y(), z);
+      const lanelet::Point3d back(
+        next_id_++, center.x() - half_width.x(), center.y() - half_width.y(), z);
+      lanelet::LineString3d traffic_mirror(next_id_++, {front, back});
+      traffic_mirror.attributes()[lanelet::AttributeName::Type] = "traffic_mirror";
+      traffic_mirror.attributes()[lanelet::AttributeName::Subtype] = drawSubtype();
+      traffic_mirror.attributes()["height"] = height(rng_);
+
+      lanelet::RuleParameterMap parameters;
+      // referred to like the lights of a traffic light regulatory element, the node reads the
+      // "traffic_mirrors" role
+      parameters[lanelet::RoleName::Refers].emplace_back(traffic_mirror);
+      parameters["traffic_mirrors"].emplace_back(traffic_mirror);
+      lanelet::AttributeMap attributes;
+      attributes[lanelet::AttributeName::Type] =
+        lanelet::AttributeValueString::RegulatoryElement;
+      attributes[lanelet::AttributeName::Subtype] =
+        lanelet::autoware::AutowareTrafficMirror::RuleName;
+      lanelet.addRegulatoryElement(lanelet::RegulatoryElementFactory::create(
+        lanelet::autoware::AutowareTrafficMirror::RuleName,
+        std::make_shared<lanelet::RegulatoryElementData>(next_id_++, parameters, attributes)));
+    }
+    map_.lanelet_map->add(lanelet);
+    return lanelet.id();
+  }
+
+  size_t drawTrafficMirrorNum()
+  {
+    const double density = std::max(config_.traffic_mirrors_per_lanelet, 0.0);
+    const double whole = std::floor(density);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    return static_cast<size_t>(whole) + (unit(rng_) < density - whole ? 1 : 0);
+  }
+
+  std::string drawSubtype()
+  {
+    ++map_.traffic_mirror_num;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    if (config_.subtypes.empty() || unit(rng_) < config_.solid_ratio) {
+      ++map_.solid_traffic_mirror_num;
+      return "solid";
+    }
+    std::uniform_int_distribution<size_t> subtype(0, config_.subtypes.size() - 1);
+    return config_.subtypes[subtype(rng_)];
+  }
+
+  void addRouteLanelet(const lanelet::Id id)
+  {
+    if (map_.route_lanelet_ids.size() < config_.route_lanelet_num) {
+      map_.route_lanelet_ids.push_back(id);
+    }
+  }
+
+  traffic_mirror::SyntheticMapConfig config_;
+  std::mt19937 rng_;
+  lanelet::Id next_id_{1};
+  std::map<std::tuple<size_t, size_t, Side>, lanelet::Point3d> points_;
+  traffic_mirror::SyntheticMap map_;
+};
+
+geometry_msgs::msg::Pose makePose(const lanelet::ConstLanelet & lanelet, const bool at_end)
+{
+  const auto centerline = lanelet.centerline();
+  const auto & front = centerline.front();
+  const auto & back = centerline.back();
+  const double yaw = std::atan2(back.y() - front.y(), back.x() - front.x());
+  geometry_msgs::msg::Pose pose;
+  pose.position.x = at_end ? back.x() : front.x();
+  pose.position.y = at_end ? back.y() : front.y();
+  pose.position.z = at_end ? back.z() : front.z();
+  pose.orientation.z = std::sin(0.5 * yaw);
+  pose.orientation.w = std::cos(0.5 * yaw);
+  return pose;
+}
+}  // namespace
+
+namespace traffic_mirror
+{
+SyntheticMap generateSyntheticMap(const SyntheticMapConfig & config)
+{
+  return SyntheticMapBuilder(config).build();
+}
+
+autoware_auto_mapping_msgs::msg::HADMapBin toHADMapBin(
+  const SyntheticMap & map, const std::string & frame_id)
+{
+  autoware_auto_mapping_msgs::msg::HADMapBin map_msg;
+  lanelet::utils::conversion::toBinMsg(map.lanelet_map, &map_msg);
+  map_msg.header.frame_id = frame_id;
+  return map_msg;
+}
+
+autoware_planning_msgs::msg::LaneletRoute toLaneletRoute(
+  const SyntheticMap & map, const std::string & frame_id)
+{
+  autoware_planning_msgs::msg::LaneletRoute route_msg;
+  route_msg.header.frame_id = frame_id;
+  if (map.route_lanelet_ids.empty()) {
+    return route_msg;
+  }
+  for (const lanelet::Id id : map.route_lanelet_ids) {
+    autoware_planning_msgs::msg::LaneletPrimitive primitive;
+    primitive.id = id;
+    primitive.primitive_type = "lane";
+    autoware_planning_msgs::msg::LaneletSegment segment;
+    segment.preferred_primitive = primitive;
+    segment.primitives.push_back(primitive);
+    route_msg.segments.push_back(segment);
+  }
+  route_msg.start_pose =
+    makePose(map.lanelet_map->laneletLayer.get(map.route_lanelet_ids.front()), false);
+  route_msg.goal_pose =
+    makePose(map.lanelet_map->laneletLayer.get(map.route_lanelet_ids.back()), true);
+  return route_msg;
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,150 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/synthetic_map.hpp"
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Publishes a synthetic map and its route once, latched, for the map based detector to
+ * load them through its usual subscriptions
+ *
+ */
+class SyntheticMapPublisher : public rclcpp::Node
+{
+public:
+  explicit SyntheticMapPublisher(const rclcpp::NodeOptions & node_options)
+  : Node("traffic_mirror_synthetic_map_publisher", node_options)
+  {
+    SyntheticMapConfig config;
+    config.grid_cols = declare_parameter<int>("grid_cols", 10);
+    config.grid_rows = declare_parameter<int>("grid_rows", 10);
+    config.block_length = declare_parameter<double>("block_length", 100.0);
+    config.lane_width = declare_parameter<double>("lane_width", 3.5);
+    config.traffic_mirrors_per_lanelet =
+      declare_parameter<double>("traffic_mirrors_per_lanelet", 1.0);
+    config.min_mount_height = declare_parameter<double>("min_mount_height", 1.5);
+    config.max_mount_height = declare_parameter<double>("max_mount_height", 3.0);
+    config.min_height = declare_parameter<double>("min_height", 0.6);
+    config.max_height = declare_parameter<double>("max_height", 1.0);
+    config.traffic_mirror_width = declare_parameter<double>("traffic_mirror_width", 0.8);
+    config.subtypes = declare_parameter<std::vector<std::string>>(
+      "subtypes", std::vector<std::string>{"round", "rectangle"});
+    config.solid_ratio = declare_parameter<double>("solid_ratio", 0.1);
+    config.route_lanelet_num = declare_parameter<int>("route_lanelet_num", 20);
+    config.seed = declare_parameter<int>("seed", 1);
+    const std::string frame_id = declare_parameter<std::string>("frame_id", "map");
+    validate(config);
+
+    const auto start = std::chrono::steady_clock::now();
+    const SyntheticMap map = generateSyntheticMap(config);
+    RCLCPP_INFO(
+      get_logger(),
+      "synthetic map is generated in %.3f s with %lu lanelets, %lu traffic mirrors (%lu solid) "
+      "and a route of %lu lanelets",
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+      map.lanelet_map->laneletLayer.size(), map.traffic_mirror_num, map.solid_traffic_mirror_num,
+      map.route_lanelet_ids.size());
+
+    map_pub_ = create_publisher<autoware_auto_mapping_msgs::msg::HADMapBin>(
+      "~/output/vector_map", rclcpp::QoS{1}.transient_local());
+    route_pub_ = create_publisher<autoware_planning_msgs::msg::LaneletRoute>(
+      "~/output/route", rclcpp::QoS{1}.transient_local());
+    auto map_msg = toHADMapBin(map, frame_id);
+    map_msg.header.stamp = now();
+    map_pub_->publish(map_msg);
+    if (!map.route_lanelet_ids.empty()) {
+      auto route_msg = toLaneletRoute(map, frame_id);
+      route_msg.header.stamp = map_msg.header.stamp;
+      route_pub_->publish(route_msg);
+    }
+  }
+
+private:
+  void validate(SyntheticMapConfig & config) const
+  {
+    // the grid sizes are read as int, so negative values show up as huge sizes
+    if (config.grid_cols < 1 || config.grid_cols > 10000) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param grid_cols = " << config.grid_cols
+                                                   << ", set to default value = 10");
+      config.grid_cols = 10;
+    }
+    if (config.grid_rows < 1 || config.grid_rows > 10000) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param grid_rows = " << config.grid_rows
+                                                   << ", set to default value = 10");
+      config.grid_rows = 10;
+    }
+    if (config.block_length <= 0.0) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param block_length = " << config.block_length
+                                                      << ", set to default value = 100.0");
+      config.block_length = 100.0;
+    }
+    if (config.lane_width <= 0.0) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param lane_width = " << config.lane_width
+                                                    << ", set to default value = 3.5");
+      config.lane_width = 3.5;
+    }
+    if (config.traffic_mirrors_per_lanelet < 0.0) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param traffic_mirrors_per_lanelet = "
+                        << config.traffic_mirrors_per_lanelet << ", set to default value = 1.0");
+      config.traffic_mirrors_per_lanelet = 1.0;
+    }
+    if (config.min_mount_height > config.max_mount_height) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param min_mount_height = "
+                        << config.min_mount_height << " > max_mount_height = "
+                        << config.max_mount_height << ", set to default values = 1.5, 3.0");
+      config.min_mount_height = 1.5;
+      config.max_mount_height = 3.0;
+    }
+    if (config.min_height <= 0.0 || config.min_height > config.max_height) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param min_height = " << config.min_height << ", max_height = "
+                                                    << config.max_height
+                                                    << ", set to default values = 0.6, 1.0");
+      config.min_height = 0.6;
+      config.max_height = 1.0;
+    }
+    if (config.traffic_mirror_width <= 0.0) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param traffic_mirror_width = " << config.traffic_mirror_width
+                                                              << ", set to default value = 0.8");
+      config.traffic_mirror_width = 0.8;
+    }
+    if (config.solid_ratio < 0.0 || config.solid_ratio > 1.0) {
+      RCLCPP_ERROR_STREAM(
+        get_logger(), "Invalid param solid_ratio = " << config.solid_ratio
+                                                     << ", set to default value = 0.1");
+      config.solid_ratio = 0.1;
+    }
+  }
+
+  rclcpp::Publisher<autoware_auto_mapping_msgs::msg::HADMapBin>::SharedPtr map_pub_;
+  rclcpp::Publisher<autoware_planning_msgs::msg::LaneletRoute>::SharedPtr route_pub_;
+};
+}  // namespace traffic_mirror
+
+#include <rclcpp_components/register_node_macro.hpp>
+RCLCPP_COMPONENTS_REGISTER_NODE(traffic_mirror::SyntheticMapPublisher)
@@ -0,0 +1,237 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/traffic_mirror_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+constexpr char cache_magic[8] = {'T', 'M', 'I', 'R', 'R', 'O', 'R', 'S'};
+// bump whenever the layout changes, files of other versions are ignored and rewritten
+constexpr uint32_t cache_version = 1;
+
+/**
+ * @brief file layout: this header, the per-mirror arrays of forEachArray, lanelet_offsets,
+ * lanelet_ids and is_valid, all packed in native byte order
+ *
+ */
+struct CacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t map_hash;
+  uint64_t mirror_num;
+  uint64_t lanelet_id_num;
+};
+
+// the 8 byte wide per-mirror arrays in file order
+constexpr size_t per_mirror_array_num = 12;
+
+template <typename TableT, typename FunctionT>
+void forEachArray(TableT & table, FunctionT function)
+{
+  function(table.ids);
+  function(table.top_left_x);
+  function(table.top_left_y);
+  function(table.top_left_z);
+  function(table.bottom_right_x);
+  function(table.bottom_right_y);
+  function(table.bottom_right_z);
+  function(table.center_x);
+  function(table.center_y);
+  function(table.center_z);
+  function(table.facing_x);
+  function(table.facing_y);
+}
+
+bool parseCache(
+  const uint8_t * data, const size_t size, const uint64_t map_hash,
+  traffic_mirror::TrafficMirrorTable & table)
+{
+  if (size < sizeof(CacheHeader)) {
+    return false;
+  }
+  CacheHeader header;
+  std::memcpy(&header, data, sizeof(CacheHeader));
+  if (
+    std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+    header.version != cache_version || header.map_hash != map_hash) {
+    return false;
+  }
+  const size_t n = header.mirror_num;
+  const size_t m = header.lanelet_id_num;
+  // also keeps the size computation below from overflowing
+  if (n > size || m > size) {
+    return false;
+  }
+  const size_t expected_size = sizeof(CacheHeader) + per_mirror_array_num * n * sizeof(double) +
+                               (n + 1) * sizeof(uint64_t) + m * sizeof(int64_t) + n;
+  if (size != expected_size) {
+    return false;
+  }
+
+  traffic_mirror::TrafficMirrorTable result;
+  const uint8_t * p = data + sizeof(CacheHeader);
+  const auto read = [&p](auto & array, const size_t len) {
+    using T = typename std::decay_t<decltype(array)>::value_type;
+    array.resize(len);
+    std::memcpy(array.data(), p, len * sizeof(T));
+    p += len * sizeof(T);
+  };
+  forEachArray(result, [&read, n](auto & array) { read(array, n); });
+  read(result.lanelet_offsets, n + 1);
+  read(result.lanelet_ids, m);
+  read(result.is_valid, n);
+  // the offsets are used as they are, reject anything out of range
+  const auto & offsets = result.lanelet_offsets;
+  if (
+    offsets.front() != 0 || offsets.back() != m ||
+    !std::is_sorted(offsets.begin(), offsets.end())) {
+    return false;
+  }
+  table = std::move(result);
+  return true;
+}
+
+// write(2) until everything is written
+bool writeAll(const int fd, const void * data, size_t size)
+{
+  const auto * p = static_cast<const uint8_t *>(data);
+  while (size > 0) {
+    const ssize_t written = ::write(fd, p, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+}  // namespace
+
+namespace traffic_mirror
+{
+uint64_t hashMapPayload(const std::vector<uint8_t> & data)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (const uint8_t byte : data) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string makeTrafficMirrorCachePath(const std::string & cache_dir, const uint64_t map_hash)
+{
+  char name[64];
+  std::snprintf(
+    name, sizeof(name), "traffic_mirrors_%016llx.bin", static_cast<unsigned long long>(map_hash));
+  return (std::filesystem::path(cache_dir) / name).string();
+}
+
+bool readTrafficMirrorCache(
+  const std::string & path, const uint64_t map_hash, TrafficMirrorTable & table)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  const size_t size = static_cast<size_t>(st.st_size);
+  void * data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  const bool is_read = parseCache(static_cast<const uint8_t *>(data), size, map_hash, table);
+  munmap(data, size);
+  return is_read;
+}
+
+bool writeTrafficMirrorCache(
+  const std::string & path, const uint64_t map_hash, const TrafficMirrorTable & table)
+{
+  const size_t n = table.size();
+  const auto & offsets = table.lanelet_offsets;
+  if (offsets.size() != n + 1 || offsets.back() != table.lanelet_ids.size()) {
+    return false;
+  }
+  std::error_code ec;
+  const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent, ec);
+    if (ec) {
+      return false;
+    }
+  }
+
+  CacheHeader header{};
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.map_hash = map_hash;
+  header.mirror_num = n;
+  header.lanelet_id_num = table.lanelet_ids.size();
+
+  // a unique temporary file, so that detectors sharing the directory never write the same one
+  std::string tmp_path = path + ".XXXXXX";
+  const int fd = mkstemp(tmp_path.data());
+  if (fd < 0) {
+    return false;
+  }
+  // mkstemp creates the file readable by its owner only
+  bool is_written = fchmod(fd, 0644) == 0 && writeAll(fd, &header, sizeof(CacheHeader));
+  const auto write = [fd, &is_written](const auto & array) {
+    using T = typename std::decay_t<decltype(array)>::value_type;
+    is_written = is_written && writeAll(fd, array.data(), array.size() * sizeof(T));
+  };
+  forEachArray(table, write);
+  write(table.lanelet_offsets);
+  write(table.lanelet_ids);
+  write(table.is_valid);
+  // the data must be on disk before the rename makes it visible
+  is_written = is_written && fsync(fd) == 0;
+  is_written = close(fd) == 0 && is_written;
+  if (!is_written) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+}  // namespace traffic_mirror
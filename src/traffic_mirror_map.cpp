@@ -0,0 +1,154 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/traffic_mirror_map.hpp"
+
+#include <lanelet2_extension/utility/query.hpp>
+#include <rclcpp/logging.hpp>
+
+#include <tf2/LinearMath/Vector3.h>
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace
+{
+struct IdLessThan
+{
+  bool operator()(
+    const lanelet::ConstLineString3d & left, const lanelet::ConstLineString3d & right) const
+  {
+    return left.id() < right.id();
+  }
+};
+
+tf2::Vector3 getTrafficMirrorTopLeft(const lanelet::ConstLineString3d & traffic_mirror)
+{
+  const auto & tl_bl = traffic_mirror.front();
+  const double tl_height = traffic_mirror.attributeOr("height", 0.0);
+  return tf2::Vector3(tl_bl.x(), tl_bl.y(), tl_bl.z() + tl_height);
+}
+
+tf2::Vector3 getTrafficMirrorBottomRight(const lanelet::ConstLineString3d & traffic_mirror)
+{
+  const auto & tl_bl = traffic_mirror.back();
+  return tf2::Vector3(tl_bl.x(), tl_bl.y(), tl_bl.z());
+}
+}  // namespace
+
+namespace traffic_mirror
+{
+TrafficMirrorTable buildTrafficMirrorTable(const lanelet::ConstLanelets & lanelets)
+{
+  // traffic mirrors and the lanelets whose regulatory elements refer to them
+  std::map<lanelet::ConstLineString3d, std::vector<lanelet::Id>, IdLessThan>
+    traffic_mirror_lanelets;
+  for (const auto & lanelet : lanelets) {
+    for (const auto & tl : lanelet::utils::query::autowareTrafficMirrors({lanelet})) {
+      // RegulatoryElement의 getParameters()를 통해 traffic_mirrors 접근
+      const auto & params = tl->getParameters();
+      auto traffic_mirrors_it = params.find("traffic_mirrors");
+      if (traffic_mirrors_it == params.end()) {
+        continue;
+      }
+      for (const auto & lsp : traffic_mirrors_it->second) {
+        if (const auto * ls = boost::get<lanelet::ConstLineString3d>(&lsp)) {
+          auto & owners = traffic_mirror_lanelets[*ls];
+          if (owners.empty() || owners.back() != lanelet.id()) {
+            owners.push_back(lanelet.id());
+          }
+        }
+      }
+    }
+  }
+
+  TrafficMirrorTable table;
+  table.reserve(traffic_mirror_lanelets.size());
+  for (const auto & [traffic_mirror, owners] : traffic_mirror_lanelets) {
+    const tf2::Vector3 top_left = getTrafficMirrorTopLeft(traffic_mirror);
+    const tf2::Vector3 bottom_right = getTrafficMirrorBottomRight(traffic_mirror);
+    const tf2::Vector3 center = (top_left + bottom_right) / 2;
+    // traffic mirror bottom left
+    const auto & tl_bl = traffic_mirror.front();
+    // traffic mirror bottom right
+    const auto & tl_br = traffic_mirror.back();
+    const double tl_yaw = std::atan2(tl_br.y() - tl_bl.y(), tl_br.x() - tl_bl.x()) + M_PI_2;
+    // some "Traffic Mirror" are actually not traffic mirrors
+    const bool is_valid = traffic_mirror.hasAttribute("subtype") &&
+                          traffic_mirror.attribute("subtype").value() != "solid";
+
+    table.ids.push_back(traffic_mirror.id());
+    table.top_left_x.push_back(top_left.x());
+    table.top_left_y.push_back(top_left.y());
+    table.top_left_z.push_back(top_left.z());
+    table.bottom_right_x.push_back(bottom_right.x());
+    table.bottom_right_y.push_back(bottom_right.y());
+    table.bottom_right_z.push_back(bottom_right.z());
+    table.center_x.push_back(center.x());
+    table.center_y.push_back(center.y());
+    table.center_z.push_back(center.z());
+    table.facing_x.push_back(std::cos(tl_yaw));
+    table.facing_y.push_back(std::sin(tl_yaw));
+    table.is_valid.push_back(is_valid ? 1 : 0);
+    table.lanelet_ids.insert(table.lanelet_ids.end(), owners.begin(), owners.end());
+    table.lanelet_offsets.push_back(table.lanelet_ids.size());
+  }
+  return table;
+}
+
+bool getRouteLaneletIds(
+  const lanelet::LaneletMap & lanelet_map,
+  const autoware_planning_msgs::msg::LaneletRoute & route_msg, const bool skip_unknown_lanelets,
+  const rclcpp::Logger & logger, std::unordered_set<lanelet::Id> & lanelet_ids,
+  size_t & missing_lanelet_num)
+{
+  missing_lanelet_num = 0;
+  for (const auto & segment : route_msg.segments) {
+    for (const auto & primitive : segment.primitives) {
+      if (!lanelet_map.laneletLayer.exists(primitive.id)) {
+        ++missing_lanelet_num;
+        if (!skip_unknown_lanelets) {
+          RCLCPP_ERROR(logger, "lanelet %ld of the route is not in the map", primitive.id);
+          return false;
+        }
+        continue;
+      }
+      lanelet_ids.insert(primitive.id);
+    }
+  }
+  if (missing_lanelet_num > 0) {
+    RCLCPP_WARN(
+      logger, "%lu lanelets of the route are not in the map and are skipped", missing_lanelet_num);
+  }
+  return true;
+}
+
+std::vector<size_t> getLaneletTrafficMirrors(
+  const TrafficMirrorTable & traffic_mirrors, const std::unordered_set<lanelet::Id> & lanelet_ids)
+{
+  std::vector<size_t> lanelet_traffic_mirrors;
+  for (size_t i = 0; i < traffic_mirrors.size(); ++i) {
+    const uint64_t first = traffic_mirrors.lanelet_offsets[i];
+    const uint64_t last = traffic_mirrors.lanelet_offsets[i + 1];
+    for (uint64_t j = first; j < last; ++j) {
+      if (lanelet_ids.count(traffic_mirrors.lanelet_ids[j]) > 0) {
+        lanelet_traffic_mirrors.push_back(i);
+        break;
+      }
+    }
+  }
+  return lanelet_traffic_mirrors;
+}
+}  // namespace traffic_mirror
@@ -0,0 +1,222 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_camera_info.hpp"
+#include "traffic_mirror_map_based_detector/camera_projector.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+
+#include <image_geometry/pinhole_camera_model.h>
+
+#include <sensor_msgs/msg/camera_info.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::CameraIntrinsics;
+using traffic_mirror::CameraProjector;
+
+// the projections only differ by the rounding of the rotation through its rodrigues vector
+constexpr double tolerance = 1e-6;
+
+struct CameraCase
+{
+  std::string distortion_model;
+  std::vector<double> d;
+  bool has_rectification;
+};
+
+std::ostream & operator<<(std::ostream & os, const CameraCase & camera_case)
+{
+  return os << camera_case.distortion_model << "/d" << camera_case.d.size()
+            << (camera_case.has_rectification ? "/rectified" : "");
+}
+
+/**
+ * @brief 1920x1080 camera, with R a small rotation and P a different camera matrix if rectified
+ *
+ */
+sensor_msgs::msg::CameraInfo makeCameraInfo(const CameraCase & camera_case)
+{
+  CameraIntrinsics intrinsics;
+  intrinsics.width = 1920;
+  intrinsics.height = 1080;
+  intrinsics.distortion_model = camera_case.distortion_model;
+  intrinsics.d = camera_case.d;
+  intrinsics.k = {1000.0, 0.0, 955.0, 0.0, 1010.0, 545.0, 0.0, 0.0, 1.0};
+  Eigen::Matrix3d r = Eigen::Matrix3d::Identity();
+  if (camera_case.has_rectification) {
+    r = (Eigen::AngleAxisd(0.02, Eigen::Vector3d::UnitX()) *
+         Eigen::AngleAxisd(-0.03, Eigen::Vector3d::UnitY()) *
+         Eigen::AngleAxisd(0.01, Eigen::Vector3d::UnitZ()))
+          .toRotationMatrix();
+    intrinsics.p = {950.0, 0.0, 960.0, 0.0, 0.0, 950.0, 540.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  } else {
+    intrinsics.p = {1000.0, 0.0, 955.0, 0.0, 0.0, 1010.0, 545.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  }
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      intrinsics.r[i * 3 + j] = r(i, j);
+    }
+  }
+  return traffic_mirror::synthetic::makeCameraInfo(intrinsics);
+}
+
+/**
+ * @brief points in front of the camera, over the image and somewhat beyond its edges
+ *
+ */
+std::vector<Eigen::Vector3d> makePoints()
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> lateral(-1.2, 1.2);
+  std::uniform_real_distribution<double> depth(1.0, 200.0);
+  std::vector<Eigen::Vector3d> points;
+  for (int i = 0; i < 1000; ++i) {
+    const double z = depth(rng);
+    points.emplace_back(lateral(rng) * z, 0.7 * lateral(rng) * z, z);
+  }
+  return points;
+}
+
+class CameraProjectorTest : public ::testing::TestWithParam<CameraCase>
+{
+};
+
+TEST_P(CameraProjectorTest, MatchesImageGeometry)
+{
+  const sensor_msgs::msg::CameraInfo camera_info = makeCameraInfo(GetParam());
+  image_geometry::PinholeCameraModel pinhole_camera_model;
+  pinhole_camera_model.fromCameraInfo(camera_info);
+  const CameraProjector projector(traffic_mirror::makeCameraIntrinsics(camera_info));
+  ASSERT_TRUE(projector.isSupported());
+
+  const std::vector<Eigen::Vector3d> points = makePoints();
+  std::vector<double> xs, ys, zs;
+  for (const auto & point : points) {
+    const cv::Point2d expected = pinhole_camera_model.unrectifyPoint(
+      pinhole_camera_model.project3dToPixel(cv::Point3d(point.x(), point.y(), point.z())));
+    double u = 0.0;
+    double v = 0.0;
+    projector.projectToRaw(point.x(), point.y(), point.z(), u, v);
+    EXPECT_NEAR(u, expected.x, tolerance);
+    EXPECT_NEAR(v, expected.y, tolerance);
+    xs.push_back(point.x());
+    ys.push_back(point.y());
+    zs.push_back(point.z());
+  }
+
+  // the batched version gives the same pixels as the per-point one
+  std::vector<double> us(points.size()), vs(points.size());
+  projector.projectToRaw(xs.data(), ys.data(), zs.data(), points.size(), us.data(), vs.data());
+  for (size_t i = 0; i < points.size(); ++i) {
+    double u = 0.0;
+    double v = 0.0;
+    projector.projectToRaw(xs[i], ys[i], zs[i], u, v);
+    EXPECT_DOUBLE_EQ(us[i], u);
+    EXPECT_DOUBLE_EQ(vs[i], v);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  DistortionModels, CameraProjectorTest,
+  ::testing::Values(
+    CameraCase{"plumb_bob", {0.0, 0.0, 0.0, 0.0, 0.0}, false},
+    CameraCase{"plumb_bob", {-0.1, 0.01, 0.001, -0.002}, false},
+    CameraCase{"plumb_bob", {-0.1, 0.01, 0.001, -0.002, 0.001}, false},
+    CameraCase{"plumb_bob", {-0.1, 0.01, 0.001, -0.002, 0.001}, true},
+    CameraCase{"rational_polynomial", {-0.1, 0.01, 0.001, -0.002, 0.001}, false},
+    CameraCase{"rational_polynomial", {-0.1, 0.01, 0.001, 0.001, 0.0, 0.05, -0.01, 0.001}, false},
+    CameraCase{"rational_polynomial", {-0.1, 0.01, 0.001, 0.001, 0.0, 0.05, -0.01, 0.001}, true}));
+
+TEST(CameraProjector, UnsupportedCameras)
+{
+  const sensor_msgs::msg::CameraInfo camera_info =
+    makeCameraInfo(CameraCase{"plumb_bob", {-0.1, 0.01, 0.001, -0.002, 0.001}, false});
+
+  sensor_msgs::msg::CameraInfo binned = camera_info;
+  binned.binning_x = 2;
+  binned.binning_y = 2;
+  EXPECT_FALSE(CameraProjector(traffic_mirror::makeCameraIntrinsics(binned)).isSupported());
+
+  sensor_msgs::msg::CameraInfo cropped = camera_info;
+  cropped.roi.x_offset = 100;
+  cropped.roi.y_offset = 50;
+  cropped.roi.width = 640;
+  cropped.roi.height = 480;
+  EXPECT_FALSE(CameraProjector(traffic_mirror::makeCameraIntrinsics(cropped)).isSupported());
+
+  sensor_msgs::msg::CameraInfo equidistant = camera_info;
+  equidistant.distortion_model = "equidistant";
+  equidistant.d = {-0.01, 0.001, 0.0, 0.0};
+  EXPECT_FALSE(CameraProjector(traffic_mirror::makeCameraIntrinsics(equidistant)).isSupported());
+
+  sensor_msgs::msg::CameraInfo odd_size = camera_info;
+  odd_size.d = {-0.1, 0.01, 0.001};
+  EXPECT_FALSE(CameraProjector(traffic_mirror::makeCameraIntrinsics(odd_size)).isSupported());
+}
+
+TEST(CameraProjector, UnsupportedCameraUsesFallback)
+{
+  sensor_msgs::msg::CameraInfo camera_info =
+    makeCameraInfo(CameraCase{"plumb_bob", {-0.1, 0.01, 0.001, -0.002, 0.001}, false});
+  camera_info.binning_x = 2;
+  camera_info.binning_y = 2;
+
+  traffic_mirror::DetectionEngine engine;
+  size_t fallback_count = 0;
+  engine.setCamera(
+    traffic_mirror::makeCameraIntrinsics(camera_info),
+    [&fallback_count](const double, const double, const double, double & u, double & v) {
+      ++fallback_count;
+      u = 100.0;
+      v = 100.0;
+    });
+  EXPECT_FALSE(engine.isProjectorSupported());
+
+  // one traffic mirror 20 m ahead of a camera looking along the map x axis, in its field of view
+  traffic_mirror::TrafficMirrorTable table;
+  table.ids.push_back(1);
+  table.top_left_x.push_back(20.0);
+  table.top_left_y.push_back(0.5);
+  table.top_left_z.push_back(2.0);
+  table.bottom_right_x.push_back(20.0);
+  table.bottom_right_y.push_back(-0.5);
+  table.bottom_right_z.push_back(1.0);
+  table.center_x.push_back(20.0);
+  table.center_y.push_back(0.0);
+  table.center_z.push_back(1.5);
+  table.facing_x.push_back(1.0);
+  table.facing_y.push_back(0.0);
+  table.is_valid.push_back(1);
+  table.lanelet_offsets.push_back(0);
+  Eigen::Isometry3d tf_map2camera = Eigen::Isometry3d::Identity();
+  tf_map2camera.linear() << 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, 0.0, -1.0, 0.0;
+  tf_map2camera.translation() << 0.0, 0.0, 1.5;
+  const traffic_mirror::PoseBundle poses = traffic_mirror::makePoseBundle(tf_map2camera, {});
+
+  std::vector<size_t> visible;
+  engine.getVisibleTrafficMirrors(table, {0}, poses, visible);
+  EXPECT_EQ(visible, std::vector<size_t>{0});
+  EXPECT_GT(fallback_count, 0u);
+}
+}  // namespace
@@ -0,0 +1,267 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_scene.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::DetectedRoi;
+using traffic_mirror::DetectionConfig;
+using traffic_mirror::DetectionEngine;
+using traffic_mirror::PoseBundle;
+using traffic_mirror::RawProjection;
+using traffic_mirror::Roi;
+using traffic_mirror::RoughRoiMode;
+using traffic_mirror::SpatialGrid;
+using traffic_mirror::TrafficMirrorTable;
+using traffic_mirror::synthetic::CameraModel;
+
+void expectEqual(const Roi & roi, const Roi & expected)
+{
+  EXPECT_EQ(roi.x_offset, expected.x_offset);
+  EXPECT_EQ(roi.y_offset, expected.y_offset);
+  EXPECT_EQ(roi.width, expected.width);
+  EXPECT_EQ(roi.height, expected.height);
+}
+
+void expectEqual(const std::vector<DetectedRoi> & rois, const std::vector<DetectedRoi> & expected)
+{
+  ASSERT_EQ(rois.size(), expected.size());
+  for (size_t i = 0; i < rois.size(); ++i) {
+    EXPECT_EQ(rois[i].traffic_mirror_id, expected[i].traffic_mirror_id);
+    expectEqual(rois[i].rough_roi, expected[i].rough_roi);
+    expectEqual(rois[i].expect_roi, expected[i].expect_roi);
+  }
+}
+
+/**
+ * @brief poses of frame i of a camera turning on the spot, pitching up and down
+ *
+ */
+PoseBundle makeFramePoses(const int frame, const size_t sample_num)
+{
+  const Eigen::Isometry3d exact = traffic_mirror::synthetic::makeCameraTransform();
+  const PoseBundle synthetic_poses = traffic_mirror::synthetic::makePoseBundle(sample_num);
+  const Eigen::AngleAxisd yaw(0.1 * frame, Eigen::Vector3d::UnitZ());
+  const Eigen::AngleAxisd pitch(0.03 * (frame % 7 - 3), Eigen::Vector3d::UnitX());
+  std::vector<Eigen::Isometry3d> samples;
+  for (const auto & sample : synthetic_poses.samples) {
+    samples.push_back(yaw * sample.tf_map2camera * pitch);
+  }
+  return traffic_mirror::makePoseBundle(yaw * exact * pitch, samples);
+}
+
+/**
+ * @brief the equidistant (fisheye) model of image_geometry, which CameraProjector does not cover
+ *
+ */
+RawProjection makeEquidistantProjection()
+{
+  const auto intrinsics = traffic_mirror::synthetic::makeCameraIntrinsics(CameraModel::Equidistant);
+  return [intrinsics](const double x, const double y, const double z, double & u, double & v) {
+    const double a = x / z;
+    const double b = y / z;
+    const double r = std::hypot(a, b);
+    const double theta = std::atan(r);
+    const double theta2 = theta * theta;
+    const auto & d = intrinsics.d;
+    const double theta_d =
+      theta * (1.0 + theta2 * (d[0] + theta2 * (d[1] + theta2 * (d[2] + theta2 * d[3]))));
+    const double scale = r > 0.0 ? theta_d / r : 1.0;
+    u = intrinsics.k[0] * a * scale + intrinsics.k[2];
+    v = intrinsics.k[4] * b * scale + intrinsics.k[5];
+  };
+}
+
+void expectInImage(const Roi & roi, const uint32_t width, const uint32_t height)
+{
+  EXPECT_GE(roi.width, 1u);
+  EXPECT_GE(roi.height, 1u);
+  EXPECT_LE(roi.width, width);
+  EXPECT_LE(roi.height, height);
+  EXPECT_LE(roi.x_offset, width - roi.width);
+  EXPECT_LE(roi.y_offset, height - roi.height);
+}
+
+class BatchProjectionTest : public ::testing::TestWithParam<std::tuple<CameraModel, RoughRoiMode>>
+{
+};
+
+TEST_P(BatchProjectionTest, MatchesScalarPath)
+{
+  const auto [model, mode] = GetParam();
+  const TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(20000, 7);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  DetectionConfig config = traffic_mirror::synthetic::makeDetectionConfig(mode);
+  DetectionEngine batch_engine(config);
+  config.batch_projection = false;
+  DetectionEngine scalar_engine(config);
+  batch_engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  scalar_engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  ASSERT_TRUE(batch_engine.isProjectorSupported());
+
+  size_t roi_num = 0;
+  for (int frame = 0; frame < 60; ++frame) {
+    const PoseBundle poses = makeFramePoses(frame, 1 + frame % 10);
+    std::vector<DetectedRoi> batch_rois;
+    std::vector<DetectedRoi> scalar_rois;
+    batch_engine.detect(table, grid, poses, batch_rois);
+    scalar_engine.detect(table, grid, poses, scalar_rois);
+    expectEqual(batch_rois, scalar_rois);
+    roi_num += batch_rois.size();
+  }
+  EXPECT_GT(roi_num, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  CameraModels, BatchProjectionTest,
+  ::testing::Combine(
+    ::testing::Values(
+      CameraModel::Pinhole, CameraModel::PlumbBob, CameraModel::RationalPolynomial),
+    ::testing::Values(RoughRoiMode::Sampling, RoughRoiMode::Analytic)));
+
+class RoiInImageTest : public ::testing::TestWithParam<std::tuple<CameraModel, RoughRoiMode>>
+{
+};
+
+TEST_P(RoiInImageTest, EveryRoiIsInsideTheImage)
+{
+  const auto [model, mode] = GetParam();
+  const TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(100000, 7);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  const auto intrinsics = traffic_mirror::synthetic::makeCameraIntrinsics(model);
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(mode));
+  engine.setCamera(intrinsics, makeEquidistantProjection());
+  ASSERT_EQ(engine.isProjectorSupported(), model != CameraModel::Equidistant);
+
+  size_t roi_num = 0;
+  for (int frame = 0; frame < 60; ++frame) {
+    const PoseBundle poses = makeFramePoses(frame, 1 + frame % 10);
+    std::vector<DetectedRoi> rois;
+    engine.detect(table, grid, poses, rois);
+    for (const auto & roi : rois) {
+      SCOPED_TRACE(::testing::Message() << "frame " << frame << " id " << roi.traffic_mirror_id);
+      expectInImage(roi.rough_roi, intrinsics.width, intrinsics.height);
+      expectInImage(roi.expect_roi, intrinsics.width, intrinsics.height);
+    }
+    roi_num += rois.size();
+  }
+  EXPECT_GT(roi_num, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  CameraModels, RoiInImageTest,
+  ::testing::Combine(
+    ::testing::Values(
+      CameraModel::Pinhole, CameraModel::PlumbBob, CameraModel::RationalPolynomial,
+      CameraModel::Equidistant),
+    ::testing::Values(RoughRoiMode::Sampling, RoughRoiMode::Analytic)));
+
+class AnalyticRoiTest : public ::testing::TestWithParam<CameraModel>
+{
+};
+
+TEST_P(AnalyticRoiTest, ContainsSampledRoi)
+{
+  const CameraModel model = GetParam();
+  const TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(100000, 7);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  DetectionEngine sampling_engine(
+    traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling));
+  DetectionEngine analytic_engine(
+    traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Analytic));
+  sampling_engine.setCamera(
+    traffic_mirror::synthetic::makeCameraIntrinsics(model), makeEquidistantProjection());
+  analytic_engine.setCamera(
+    traffic_mirror::synthetic::makeCameraIntrinsics(model), makeEquidistantProjection());
+
+  size_t roi_num = 0;
+  for (int frame = 0; frame < 60; ++frame) {
+    const PoseBundle poses = makeFramePoses(frame, 1 + frame % 10);
+    std::vector<DetectedRoi> sampled_rois;
+    std::vector<DetectedRoi> analytic_rois;
+    sampling_engine.detect(table, grid, poses, sampled_rois);
+    analytic_engine.detect(table, grid, poses, analytic_rois);
+    // both are in the order of the visible traffic mirrors
+    auto analytic_roi = analytic_rois.begin();
+    for (const auto & sampled_roi : sampled_rois) {
+      SCOPED_TRACE(
+        ::testing::Message() << "frame " << frame << " id " << sampled_roi.traffic_mirror_id);
+      while (analytic_roi != analytic_rois.end() &&
+             analytic_roi->traffic_mirror_id != sampled_roi.traffic_mirror_id) {
+        ++analytic_roi;
+      }
+      ASSERT_NE(analytic_roi, analytic_rois.end());
+      const Roi & outer = analytic_roi->rough_roi;
+      const Roi & inner = sampled_roi.rough_roi;
+      EXPECT_LE(outer.x_offset, inner.x_offset);
+      EXPECT_LE(outer.y_offset, inner.y_offset);
+      EXPECT_GE(outer.x_offset + outer.width, inner.x_offset + inner.width);
+      EXPECT_GE(outer.y_offset + outer.height, inner.y_offset + inner.height);
+    }
+    roi_num += sampled_rois.size();
+  }
+  EXPECT_GT(roi_num, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  CameraModels, AnalyticRoiTest,
+  ::testing::Values(
+    CameraModel::Pinhole, CameraModel::PlumbBob, CameraModel::RationalPolynomial,
+    CameraModel::Equidistant));
+
+class ViewFrustumTest : public ::testing::TestWithParam<CameraModel>
+{
+};
+
+TEST_P(ViewFrustumTest, KeepsEveryVisibleTrafficMirror)
+{
+  const CameraModel model = GetParam();
+  const TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(100000, 7);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  DetectionConfig config = traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling);
+  DetectionEngine culling_engine(config);
+  config.view_frustum_culling = false;
+  DetectionEngine engine(config);
+  culling_engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(model));
+
+  size_t visible_num = 0;
+  for (int frame = 0; frame < 20; ++frame) {
+    const PoseBundle poses = makeFramePoses(frame, 10);
+    std::vector<size_t> candidates;
+    engine.getCandidateTrafficMirrors(grid, poses, candidates);
+    std::vector<size_t> culled_visible;
+    std::vector<size_t> visible;
+    culling_engine.getVisibleTrafficMirrors(table, candidates, poses, culled_visible);
+    engine.getVisibleTrafficMirrors(table, candidates, poses, visible);
+    EXPECT_EQ(culled_visible, visible) << "frame " << frame;
+    visible_num += visible.size();
+  }
+  EXPECT_GT(visible_num, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  CameraModels, ViewFrustumTest,
+  ::testing::Values(CameraModel::Pinhole, CameraModel::PlumbBob, CameraModel::RationalPolynomial));
+}  // namespace
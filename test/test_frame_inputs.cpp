@@ -0,0 +1,93 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+
+#include <rclcpp/duration.hpp>
+#include <rclcpp/time.hpp>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Transform.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+const rclcpp::Time stamp(100, 0, RCL_ROS_TIME);
+
+/**
+ * @brief camera moving at a constant velocity and yaw rate, so that interpolating between any
+ * two of its poses gives its pose in between
+ *
+ */
+tf2::Transform getPose(const rclcpp::Time & t)
+{
+  const double dt = (t - stamp).seconds();
+  tf2::Quaternion rotation;
+  rotation.setRPY(0.0, 0.0, 0.5 + 0.3 * dt);
+  return tf2::Transform(rotation, tf2::Vector3(10.0 + 15.0 * dt, 5.0 + 2.0 * dt, 1.5));
+}
+
+bool lookup(const rclcpp::Time & t, tf2::Transform & tf)
+{
+  tf = getPose(t);
+  return true;
+}
+
+bool isFinite(const tf2::Transform & tf)
+{
+  const tf2::Quaternion rotation = tf.getRotation();
+  return std::isfinite(tf.getOrigin().x()) && std::isfinite(tf.getOrigin().y()) &&
+         std::isfinite(tf.getOrigin().z()) && std::isfinite(rotation.x()) &&
+         std::isfinite(rotation.y()) && std::isfinite(rotation.z()) && std::isfinite(rotation.w());
+}
+
+TEST(SampleTransforms, MatchesExactLookups)
+{
+  traffic_mirror::TimestampSampling sampling;
+  sampling.min_timestamp_offset = -0.1;
+  sampling.max_timestamp_offset = 0.05;
+  sampling.timestamp_sample_len = 0.01;
+  std::vector<tf2::Transform> tf_map2camera_vec;
+  traffic_mirror::sampleTransforms(sampling, stamp, getPose(stamp), lookup, tf_map2camera_vec);
+
+  ASSERT_EQ(tf_map2camera_vec.size(), 16u);
+  rclcpp::Time t = stamp + rclcpp::Duration::from_seconds(sampling.min_timestamp_offset);
+  for (const auto & tf : tf_map2camera_vec) {
+    const tf2::Transform expected = getPose(t);
+    EXPECT_NEAR(tf.getOrigin().distance(expected.getOrigin()), 0.0, 1e-9);
+    EXPECT_NEAR(tf.getRotation().angleShortestPath(expected.getRotation()), 0.0, 1e-9);
+    t += rclcpp::Duration::from_seconds(sampling.timestamp_sample_len);
+  }
+}
+
+TEST(SampleTransforms, EqualOffsets)
+{
+  for (const double offset : {-0.05, 0.0, 0.05}) {
+    for (const bool adaptive_sampling : {false, true}) {
+      traffic_mirror::TimestampSampling sampling;
+      sampling.min_timestamp_offset = offset;
+      sampling.max_timestamp_offset = offset;
+      sampling.adaptive_sampling = adaptive_sampling;
+      std::vector<tf2::Transform> tf_map2camera_vec;
+      traffic_mirror::sampleTransforms(sampling, stamp, getPose(stamp), lookup, tf_map2camera_vec);
+
+      ASSERT_EQ(tf_map2camera_vec.size(), 1u);
+      EXPECT_TRUE(isFinite(tf_map2camera_vec[0]));
+    }
+  }
+}
+}  // namespace
@@ -0,0 +1,331 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_camera_info.hpp"
+#include "synthetic_scene.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+
+#include <image_geometry/pinhole_camera_model.h>
+
+#include <sensor_msgs/msg/camera_info.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::CameraIntrinsics;
+using traffic_mirror::DetectedRoi;
+using traffic_mirror::DetectionConfig;
+using traffic_mirror::DetectionEngine;
+using traffic_mirror::PoseBundle;
+using traffic_mirror::Roi;
+using traffic_mirror::RoughRoiMode;
+using traffic_mirror::SpatialGrid;
+using traffic_mirror::TrafficMirrorTable;
+using traffic_mirror::VibrationBound;
+using traffic_mirror::synthetic::CameraModel;
+
+/*
+ * The per-mirror pipeline of the node before DetectionEngine, on the traffic mirror table instead
+ * of the lanelet line strings and on Eigen instead of tf2 transforms: every traffic mirror is
+ * checked under every sampled pose, the angle check compares yaws with acos, and every corner is
+ * projected through image_geometry.
+ */
+
+cv::Point2d calcRawImagePointFromPoint3D(
+  const image_geometry::PinholeCameraModel & pinhole_camera_model, const Eigen::Vector3d & point3d)
+{
+  cv::Point2d rectified_image_point =
+    pinhole_camera_model.project3dToPixel(cv::Point3d(point3d.x(), point3d.y(), point3d.z()));
+  return pinhole_camera_model.unrectifyPoint(rectified_image_point);
+}
+
+void roundInImageFrame(
+  const image_geometry::PinholeCameraModel & pinhole_camera_model, cv::Point2d & point)
+{
+  const sensor_msgs::msg::CameraInfo camera_info = pinhole_camera_model.cameraInfo();
+  point.x =
+    std::max(std::min(point.x, static_cast<double>(static_cast<int>(camera_info.width) - 1)), 0.0);
+  point.y =
+    std::max(std::min(point.y, static_cast<double>(static_cast<int>(camera_info.height) - 1)), 0.0);
+}
+
+bool isInDistanceRange(
+  const Eigen::Vector3d & p1, const Eigen::Vector3d & p2, const double max_distance_range)
+{
+  const double sq_dist =
+    (p1.x() - p2.x()) * (p1.x() - p2.x()) + (p1.y() - p2.y()) * (p1.y() - p2.y());
+  return sq_dist < (max_distance_range * max_distance_range);
+}
+
+bool isInAngleRange(const double & tl_yaw, const double & camera_yaw, const double max_angle_range)
+{
+  Eigen::Vector2d vec1, vec2;
+  vec1 << std::cos(tl_yaw), std::sin(tl_yaw);
+  vec2 << std::cos(camera_yaw), std::sin(camera_yaw);
+  const double diff_angle = std::acos(vec1.dot(vec2));
+  return std::fabs(diff_angle) < max_angle_range;
+}
+
+bool isInImageFrame(
+  const image_geometry::PinholeCameraModel & pinhole_camera_model, const Eigen::Vector3d & point)
+{
+  if (point.z() <= 0.0) {
+    return false;
+  }
+
+  cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point);
+  if (0 <= point2d.x && point2d.x < pinhole_camera_model.cameraInfo().width) {
+    if (0 <= point2d.y && point2d.y < pinhole_camera_model.cameraInfo().height) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Eigen::Vector3d getTrafficMirrorTopLeft(const TrafficMirrorTable & table, const size_t i)
+{
+  return Eigen::Vector3d(table.top_left_x[i], table.top_left_y[i], table.top_left_z[i]);
+}
+
+Eigen::Vector3d getTrafficMirrorBottomRight(const TrafficMirrorTable & table, const size_t i)
+{
+  return Eigen::Vector3d(table.bottom_right_x[i], table.bottom_right_y[i], table.bottom_right_z[i]);
+}
+
+std::vector<size_t> getVisibleTrafficMirrors(
+  const TrafficMirrorTable & table, const std::vector<Eigen::Isometry3d> & tf_map2camera_vec,
+  const image_geometry::PinholeCameraModel & pinhole_camera_model, const DetectionConfig & config)
+{
+  std::vector<size_t> visible_traffic_mirrors;
+  for (size_t i = 0; i < table.size(); ++i) {
+    if (!table.is_valid[i]) {
+      continue;
+    }
+    const Eigen::Vector3d tl_bl = getTrafficMirrorTopLeft(table, i);
+    const Eigen::Vector3d tl_br = getTrafficMirrorBottomRight(table, i);
+    const Eigen::Vector3d tl_center = (tl_bl + tl_br) / 2;
+    for (const auto & tf_map2camera : tf_map2camera_vec) {
+      if (!isInDistanceRange(tl_center, tf_map2camera.translation(), config.max_detection_range)) {
+        continue;
+      }
+
+      const double tl_yaw = std::atan2(tl_br.y() - tl_bl.y(), tl_br.x() - tl_bl.x()) + M_PI_2;
+      const Eigen::Vector3d camera_z_dir = tf_map2camera.linear() * Eigen::Vector3d::UnitZ();
+      const double camera_yaw = std::atan2(camera_z_dir.y(), camera_z_dir.x());
+      if (!isInAngleRange(tl_yaw, camera_yaw, config.max_angle_range)) {
+        continue;
+      }
+
+      const Eigen::Vector3d tf_camera2tltl = tf_map2camera.inverse() * tl_bl;
+      const Eigen::Vector3d tf_camera2tlbr = tf_map2camera.inverse() * tl_br;
+      if (
+        !isInImageFrame(pinhole_camera_model, tf_camera2tltl) &&
+        !isInImageFrame(pinhole_camera_model, tf_camera2tlbr)) {
+        continue;
+      }
+      visible_traffic_mirrors.push_back(i);
+      break;
+    }
+  }
+  return visible_traffic_mirrors;
+}
+
+bool getTrafficMirrorRoi(
+  const Eigen::Isometry3d & tf_map2camera,
+  const image_geometry::PinholeCameraModel & pinhole_camera_model,
+  const TrafficMirrorTable & table, const size_t i, const VibrationBound & config, Roi & roi)
+{
+  // for roi.x_offset and roi.y_offset
+  {
+    const Eigen::Vector3d camera2tl = tf_map2camera.inverse() * getTrafficMirrorTopLeft(table, i);
+    const double max_vibration_x =
+      std::sin(config.max_vibration_yaw * 0.5) * camera2tl.z() + config.max_vibration_width * 0.5;
+    const double max_vibration_y = std::sin(config.max_vibration_pitch * 0.5) * camera2tl.z() +
+                                   config.max_vibration_height * 0.5;
+    const double max_vibration_z = config.max_vibration_depth * 0.5;
+    const Eigen::Vector3d point3d =
+      camera2tl - Eigen::Vector3d(max_vibration_x, max_vibration_y, max_vibration_z);
+    if (point3d.z() <= 0.0) {
+      return false;
+    }
+    cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point3d);
+    roundInImageFrame(pinhole_camera_model, point2d);
+    roi.x_offset = point2d.x;
+    roi.y_offset = point2d.y;
+  }
+
+  // for roi.width and roi.height
+  {
+    const Eigen::Vector3d camera2tl =
+      tf_map2camera.inverse() * getTrafficMirrorBottomRight(table, i);
+    const double max_vibration_x =
+      std::sin(config.max_vibration_yaw * 0.5) * camera2tl.z() + config.max_vibration_width * 0.5;
+    const double max_vibration_y = std::sin(config.max_vibration_pitch * 0.5) * camera2tl.z() +
+                                   config.max_vibration_height * 0.5;
+    const double max_vibration_z = config.max_vibration_depth * 0.5;
+    const Eigen::Vector3d point3d =
+      camera2tl + Eigen::Vector3d(max_vibration_x, max_vibration_y, -max_vibration_z);
+    if (point3d.z() <= 0.0) {
+      return false;
+    }
+    cv::Point2d point2d = calcRawImagePointFromPoint3D(pinhole_camera_model, point3d);
+    roundInImageFrame(pinhole_camera_model, point2d);
+    // the old node stored a negative difference unsigned and kept the wrapped roi, which the
+    // engine rejects
+    if (point2d.x - roi.x_offset < 1.0 || point2d.y - roi.y_offset < 1.0) {
+      return false;
+    }
+    roi.width = point2d.x - roi.x_offset;
+    roi.height = point2d.y - roi.y_offset;
+  }
+  return true;
+}
+
+bool getTrafficMirrorRoi(
+  const std::vector<Eigen::Isometry3d> & tf_map2camera_vec,
+  const image_geometry::PinholeCameraModel & pinhole_camera_model,
+  const TrafficMirrorTable & table, const size_t i, const VibrationBound & config, Roi & out_roi)
+{
+  std::vector<Roi> rois;
+  for (const auto & tf_map2camera : tf_map2camera_vec) {
+    Roi roi;
+    if (getTrafficMirrorRoi(tf_map2camera, pinhole_camera_model, table, i, config, roi)) {
+      rois.push_back(roi);
+    }
+  }
+  if (rois.empty()) {
+    return false;
+  }
+  uint32_t x1 = pinhole_camera_model.cameraInfo().width - 1;
+  uint32_t x2 = 0;
+  uint32_t y1 = pinhole_camera_model.cameraInfo().height - 1;
+  uint32_t y2 = 0;
+  for (const auto & roi : rois) {
+    x1 = std::min(x1, roi.x_offset);
+    x2 = std::max(x2, roi.x_offset + roi.width);
+    y1 = std::min(y1, roi.y_offset);
+    y2 = std::max(y2, roi.y_offset + roi.height);
+  }
+  out_roi.x_offset = x1;
+  out_roi.y_offset = y1;
+  out_roi.width = x2 - x1;
+  out_roi.height = y2 - y1;
+  return true;
+}
+
+std::vector<DetectedRoi> detectLegacy(
+  const TrafficMirrorTable & table, const Eigen::Isometry3d & tf_map2camera,
+  const std::vector<Eigen::Isometry3d> & tf_map2camera_vec,
+  const image_geometry::PinholeCameraModel & pinhole_camera_model, const DetectionConfig & config)
+{
+  std::vector<DetectedRoi> rois;
+  for (const size_t i :
+       getVisibleTrafficMirrors(table, tf_map2camera_vec, pinhole_camera_model, config)) {
+    DetectedRoi roi;
+    roi.traffic_mirror_id = table.ids[i];
+    if (!getTrafficMirrorRoi(
+          tf_map2camera, pinhole_camera_model, table, i, VibrationBound{}, roi.expect_roi)) {
+      continue;
+    }
+    if (!getTrafficMirrorRoi(
+          tf_map2camera_vec, pinhole_camera_model, table, i, config.vibration, roi.rough_roi)) {
+      continue;
+    }
+    rois.push_back(roi);
+  }
+  return rois;
+}
+
+/**
+ * @brief poses of frame i of a camera turning on the spot, pitching up and down
+ *
+ */
+std::vector<Eigen::Isometry3d> makeFrameTransforms(const int frame, const size_t sample_num)
+{
+  const PoseBundle synthetic_poses = traffic_mirror::synthetic::makePoseBundle(sample_num);
+  const Eigen::AngleAxisd yaw(0.1 * frame, Eigen::Vector3d::UnitZ());
+  const Eigen::AngleAxisd pitch(0.03 * (frame % 7 - 3), Eigen::Vector3d::UnitX());
+  std::vector<Eigen::Isometry3d> samples;
+  for (const auto & sample : synthetic_poses.samples) {
+    samples.push_back(yaw * sample.tf_map2camera * pitch);
+  }
+  return samples;
+}
+
+void expectNear(const Roi & roi, const Roi & expected, const int64_t tolerance)
+{
+  EXPECT_LE(std::abs(static_cast<int64_t>(roi.x_offset) - expected.x_offset), tolerance);
+  EXPECT_LE(std::abs(static_cast<int64_t>(roi.y_offset) - expected.y_offset), tolerance);
+  EXPECT_LE(std::abs(static_cast<int64_t>(roi.width) - expected.width), tolerance);
+  EXPECT_LE(std::abs(static_cast<int64_t>(roi.height) - expected.height), tolerance);
+}
+
+void expectNear(
+  const std::vector<DetectedRoi> & rois, const std::vector<DetectedRoi> & expected,
+  const int64_t tolerance)
+{
+  ASSERT_EQ(rois.size(), expected.size());
+  for (size_t i = 0; i < rois.size(); ++i) {
+    EXPECT_EQ(rois[i].traffic_mirror_id, expected[i].traffic_mirror_id);
+    expectNear(rois[i].rough_roi, expected[i].rough_roi, tolerance);
+    expectNear(rois[i].expect_roi, expected[i].expect_roi, tolerance);
+  }
+}
+
+class LegacyPipelineTest : public ::testing::TestWithParam<CameraModel>
+{
+};
+
+TEST_P(LegacyPipelineTest, MatchesDetectionEngine)
+{
+  const CameraIntrinsics intrinsics = traffic_mirror::synthetic::makeCameraIntrinsics(GetParam());
+  image_geometry::PinholeCameraModel pinhole_camera_model;
+  pinhole_camera_model.fromCameraInfo(traffic_mirror::synthetic::makeCameraInfo(intrinsics));
+  const TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(20000, 7);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  const DetectionConfig config =
+    traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling);
+  DetectionEngine engine(config);
+  engine.setCamera(intrinsics);
+  ASSERT_TRUE(engine.isProjectorSupported());
+
+  size_t roi_num = 0;
+  for (int frame = 0; frame < 30; ++frame) {
+    const std::vector<Eigen::Isometry3d> samples = makeFrameTransforms(frame, 1 + frame % 10);
+    const Eigen::Isometry3d exact = samples[samples.size() / 2];
+    const PoseBundle poses = traffic_mirror::makePoseBundle(exact, samples);
+    const std::vector<DetectedRoi> expected =
+      detectLegacy(table, exact, samples, pinhole_camera_model, config);
+    std::vector<DetectedRoi> rois;
+    engine.detect(table, grid, poses, rois);
+    // CameraProjector and image_geometry differ by rounding, which may move a roi edge by a pixel
+    expectNear(rois, expected, 1);
+    roi_num += expected.size();
+  }
+  EXPECT_GT(roi_num, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  CameraModels, LegacyPipelineTest,
+  ::testing::Values(CameraModel::Pinhole, CameraModel::PlumbBob, CameraModel::RationalPolynomial));
+}  // namespace
@@ -0,0 +1,197 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/route_horizon.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::RouteHorizon;
+using traffic_mirror::RouteHorizonTracker;
+
+constexpr double ahead = 50.0;
+constexpr double behind = 20.0;
+
+/**
+ * @brief route of straight segments, with one traffic mirror every 10 m, 3 m left of the segment
+ * it belongs to. They are off the 2.5 m steps of the camera, so no window ends on one
+ *
+ */
+struct Route
+{
+  std::vector<RouteHorizon::Polyline> centerlines;
+  std::vector<std::vector<size_t>> segment_traffic_mirrors;
+  std::vector<double> center_x;
+  std::vector<double> center_y;
+
+  void addSegment(const double x1, const double y1, const double x2, const double y2)
+  {
+    centerlines.push_back({{x1, y1}, {x2, y2}});
+    segment_traffic_mirrors.emplace_back();
+    const double length = std::hypot(x2 - x1, y2 - y1);
+    const double left_x = -(y2 - y1) / length * 3.0;
+    const double left_y = (x2 - x1) / length * 3.0;
+    for (double s = 4.2; s < length; s += 10.0) {
+      segment_traffic_mirrors.back().push_back(center_x.size());
+      center_x.push_back(x1 + (x2 - x1) * s / length + left_x);
+      center_y.push_back(y1 + (y2 - y1) * s / length + left_y);
+    }
+  }
+
+  std::shared_ptr<const RouteHorizon> makeHorizon() const
+  {
+    return std::make_shared<const RouteHorizon>(
+      centerlines, segment_traffic_mirrors, center_x, center_y);
+  }
+};
+
+/**
+ * @brief traffic mirrors of the window around arc length s, by a scan of every entry
+ *
+ */
+std::vector<size_t> getWindow(const RouteHorizon & horizon, const double s)
+{
+  std::vector<size_t> traffic_mirrors;
+  for (size_t entry = 0; entry < horizon.size(); ++entry) {
+    const double entry_s = horizon.entryArcLength(entry);
+    if (s - behind <= entry_s && entry_s <= s + ahead) {
+      traffic_mirrors.push_back(horizon.entryTrafficMirror(entry));
+    }
+  }
+  std::sort(traffic_mirrors.begin(), traffic_mirrors.end());
+  traffic_mirrors.erase(
+    std::unique(traffic_mirrors.begin(), traffic_mirrors.end()), traffic_mirrors.end());
+  return traffic_mirrors;
+}
+
+TEST(RouteHorizonTest, StraightRouteForwardThenBackward)
+{
+  Route route;
+  for (int i = 0; i < 10; ++i) {
+    route.addSegment(100.0 * i, 0.0, 100.0 * (i + 1), 0.0);
+  }
+  const auto horizon = route.makeHorizon();
+  ASSERT_EQ(horizon->size(), route.center_x.size());
+
+  RouteHorizonTracker tracker;
+  std::vector<double> xs;
+  for (double x = 0.0; x <= 1000.0; x += 2.5) {
+    xs.push_back(x);
+  }
+  for (double x = 1000.0; x >= 0.0; x -= 2.5) {
+    xs.push_back(x);
+  }
+  for (const double x : xs) {
+    std::vector<size_t> traffic_mirrors;
+    tracker.update(horizon, x, 1.0, ahead, behind, traffic_mirrors);
+    EXPECT_EQ(traffic_mirrors, getWindow(*horizon, x)) << "x " << x;
+    EXPECT_NEAR(horizon->locate(x, 1.0, x, true), x, 1e-9);
+  }
+}
+
+TEST(RouteHorizonTest, LaneChangeWithinOneSegment)
+{
+  // the preferred lanelet of the second segment is one lane to the left
+  Route route;
+  route.addSegment(0.0, 0.0, 100.0, 0.0);
+  route.addSegment(100.0, 3.5, 200.0, 3.5);
+  route.addSegment(200.0, 3.5, 300.0, 3.5);
+  const auto horizon = route.makeHorizon();
+
+  // The camera changes lanes halfway through the first segment. Until the next segment it is a
+  // lane width from the centerline, and is located on the closest point of the route
+  RouteHorizonTracker tracker;
+  double prev_s = 0.0;
+  for (double x = 0.0; x <= 300.0; x += 2.5) {
+    const double y = std::clamp((x - 30.0) / 40.0, 0.0, 1.0) * 3.5;
+    const double s = horizon->locate(x, y, 0.0, false);
+    EXPECT_NEAR(s, x, 3.5) << "x " << x;
+    EXPECT_GE(s, prev_s) << "x " << x;
+    prev_s = s;
+    std::vector<size_t> traffic_mirrors;
+    tracker.update(horizon, x, y, ahead, behind, traffic_mirrors);
+    EXPECT_EQ(traffic_mirrors, getWindow(*horizon, s)) << "x " << x;
+  }
+}
+
+TEST(RouteHorizonTest, CameraFarFromRoute)
+{
+  // out along y = 0 and back along y = 50, 2050 m in total
+  Route route;
+  route.addSegment(0.0, 0.0, 1000.0, 0.0);
+  route.addSegment(1000.0, 0.0, 1000.0, 50.0);
+  route.addSegment(1000.0, 50.0, 0.0, 50.0);
+  const auto horizon = route.makeHorizon();
+
+  RouteHorizonTracker tracker;
+  std::vector<size_t> traffic_mirrors;
+  tracker.update(horizon, 100.0, 0.0, ahead, behind, traffic_mirrors);
+  EXPECT_EQ(traffic_mirrors, getWindow(*horizon, 100.0));
+
+  // the return leg is within the search range of the hint but 50 m from the centerline around
+  // it, so the whole route is searched
+  EXPECT_NEAR(horizon->locate(100.0, 50.0, 100.0, true), 1950.0, 1e-9);
+  traffic_mirrors.clear();
+  tracker.update(horizon, 100.0, 50.0, ahead, behind, traffic_mirrors);
+  EXPECT_EQ(traffic_mirrors, getWindow(*horizon, 1950.0));
+
+  // beyond the search range of the hint, the closest centerline is still found
+  EXPECT_NEAR(horizon->locate(700.0, -20.0, 1950.0, true), 700.0, 1e-9);
+  traffic_mirrors.clear();
+  tracker.update(horizon, 700.0, -20.0, ahead, behind, traffic_mirrors);
+  EXPECT_EQ(traffic_mirrors, getWindow(*horizon, 700.0));
+}
+
+TEST(RouteHorizonTest, NewHorizonResetsWindow)
+{
+  Route first_route;
+  first_route.addSegment(0.0, 0.0, 1000.0, 0.0);
+  const auto first_horizon = first_route.makeHorizon();
+  // the same road, driven the other way
+  Route second_route;
+  second_route.addSegment(1000.0, 0.0, 0.0, 0.0);
+  const auto second_horizon = second_route.makeHorizon();
+
+  RouteHorizonTracker tracker;
+  std::vector<size_t> traffic_mirrors;
+  for (double x = 0.0; x <= 800.0; x += 5.0) {
+    traffic_mirrors.clear();
+    tracker.update(first_horizon, x, 0.0, ahead, behind, traffic_mirrors);
+  }
+  EXPECT_EQ(traffic_mirrors, getWindow(*first_horizon, 800.0));
+
+  // the window of the new horizon does not start from the position on the old one
+  traffic_mirrors.clear();
+  tracker.update(second_horizon, 800.0, 0.0, ahead, behind, traffic_mirrors);
+  EXPECT_EQ(traffic_mirrors, getWindow(*second_horizon, 200.0));
+  EXPECT_FALSE(traffic_mirrors.empty());
+
+  // nor does a horizon rebuilt from the same route
+  const auto rebuilt_horizon = second_route.makeHorizon();
+  traffic_mirrors.clear();
+  tracker.update(rebuilt_horizon, 100.0, 0.0, ahead, behind, traffic_mirrors);
+  EXPECT_EQ(traffic_mirrors, getWindow(*rebuilt_horizon, 900.0));
+
+  // no horizon, no traffic mirror
+  traffic_mirrors.clear();
+  tracker.update(nullptr, 100.0, 0.0, ahead, behind, traffic_mirrors);
+  EXPECT_TRUE(traffic_mirrors.empty());
+}
+}  // namespace
@@ -0,0 +1,133 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_scene.hpp"
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/synthetic_map.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_map.hpp"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+#include <lanelet2_extension/utility/message_conversion.hpp>
+#include <lanelet2_extension/utility/query.hpp>
+#include <rclcpp/logging.hpp>
+
+#include <lanelet2_core/LaneletMap.h>
+#include <lanelet2_core/primitives/Lanelet.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::DetectionEngine;
+using traffic_mirror::PoseBundle;
+using traffic_mirror::RoughRoiMode;
+using traffic_mirror::SpatialGrid;
+using traffic_mirror::SyntheticMap;
+using traffic_mirror::SyntheticMapConfig;
+using traffic_mirror::TrafficMirrorTable;
+
+/**
+ * @brief camera 1.5 m above the start of the centerline of a lanelet, looking along it
+ *
+ */
+Eigen::Isometry3d makeCameraTransform(const lanelet::ConstLanelet & lanelet)
+{
+  const auto centerline = lanelet.centerline();
+  const Eigen::Vector3d start(centerline.front().x(), centerline.front().y(), 1.5);
+  const Eigen::Vector3d forward =
+    Eigen::Vector3d(
+      centerline.back().x() - centerline.front().x(),
+      centerline.back().y() - centerline.front().y(), 0.0)
+      .normalized();
+  Eigen::Isometry3d tf_map2camera = Eigen::Isometry3d::Identity();
+  // camera z forward, camera x to the right of forward, camera y down
+  tf_map2camera.linear().col(0) = Eigen::Vector3d(forward.y(), -forward.x(), 0.0);
+  tf_map2camera.linear().col(1) = -Eigen::Vector3d::UnitZ();
+  tf_map2camera.linear().col(2) = forward;
+  tf_map2camera.translation() = start;
+  return tf_map2camera;
+}
+
+TEST(SyntheticMapTest, MapMessageRoundTrip)
+{
+  const SyntheticMap map = traffic_mirror::generateSyntheticMap(SyntheticMapConfig{});
+  auto lanelet_map = std::make_shared<lanelet::LaneletMap>();
+  lanelet::utils::conversion::fromBinMsg(traffic_mirror::toHADMapBin(map), lanelet_map);
+  const TrafficMirrorTable table =
+    traffic_mirror::buildTrafficMirrorTable(lanelet::utils::query::laneletLayer(lanelet_map));
+  EXPECT_EQ(table.size(), map.traffic_mirror_num);
+  EXPECT_EQ(
+    static_cast<size_t>(std::count(table.is_valid.begin(), table.is_valid.end(), 0)),
+    map.solid_traffic_mirror_num);
+}
+
+TEST(SyntheticMapTest, RouteMessageRoundTrip)
+{
+  const SyntheticMap map = traffic_mirror::generateSyntheticMap(SyntheticMapConfig{});
+  auto lanelet_map = std::make_shared<lanelet::LaneletMap>();
+  lanelet::utils::conversion::fromBinMsg(traffic_mirror::toHADMapBin(map), lanelet_map);
+  std::unordered_set<lanelet::Id> lanelet_ids;
+  size_t missing_lanelet_num = 0;
+  ASSERT_TRUE(traffic_mirror::getRouteLaneletIds(
+    *lanelet_map, traffic_mirror::toLaneletRoute(map), false,
+    rclcpp::get_logger("test_synthetic_map"), lanelet_ids, missing_lanelet_num));
+  EXPECT_EQ(missing_lanelet_num, 0u);
+  EXPECT_EQ(
+    lanelet_ids,
+    std::unordered_set<lanelet::Id>(map.route_lanelet_ids.begin(), map.route_lanelet_ids.end()));
+}
+
+TEST(SyntheticMapTest, RouteCameraSeesTrafficMirrors)
+{
+  const SyntheticMap map = traffic_mirror::generateSyntheticMap(SyntheticMapConfig{});
+  ASSERT_FALSE(map.route_lanelet_ids.empty());
+  lanelet::ConstLanelets route_lanelets;
+  for (const lanelet::Id id : map.route_lanelet_ids) {
+    route_lanelets.push_back(map.lanelet_map->laneletLayer.get(id));
+  }
+  const TrafficMirrorTable table = traffic_mirror::buildTrafficMirrorTable(route_lanelets);
+  const SpatialGrid grid(table.center_x, table.center_y, 200.0);
+  DetectionEngine engine(traffic_mirror::synthetic::makeDetectionConfig(RoughRoiMode::Sampling));
+  engine.setCamera(traffic_mirror::synthetic::makeCameraIntrinsics(
+    traffic_mirror::synthetic::CameraModel::Pinhole));
+
+  // every detectable traffic mirror of a route lanelet stands ahead of a camera at its start
+  size_t expected_num = 0;
+  for (const auto & lanelet : route_lanelets) {
+    const Eigen::Isometry3d tf_map2camera = makeCameraTransform(lanelet);
+    const PoseBundle poses = traffic_mirror::makePoseBundle(tf_map2camera, {tf_map2camera});
+    std::vector<size_t> candidates;
+    engine.getCandidateTrafficMirrors(grid, poses, candidates);
+    std::vector<size_t> visible;
+    engine.getVisibleTrafficMirrors(table, candidates, poses, visible);
+    for (size_t i = 0; i < table.size(); ++i) {
+      const auto first = table.lanelet_ids.begin() + table.lanelet_offsets[i];
+      const auto last = table.lanelet_ids.begin() + table.lanelet_offsets[i + 1];
+      if (!table.is_valid[i] || std::find(first, last, lanelet.id()) == last) {
+        continue;
+      }
+      EXPECT_NE(std::find(visible.begin(), visible.end(), i), visible.end())
+        << "traffic mirror " << table.ids[i] << " of lanelet " << lanelet.id();
+      ++expected_num;
+    }
+  }
+  EXPECT_GT(expected_num, 0u);
+}
+}  // namespace
@@ -0,0 +1,199 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "synthetic_scene.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+using traffic_mirror::TrafficMirrorTable;
+
+constexpr uint64_t map_hash = 0x0123456789abcdefULL;
+// byte offsets of the fields of the file header
+constexpr size_t version_offset = 8;
+constexpr size_t header_size = 40;
+constexpr size_t per_mirror_array_num = 12;
+
+/**
+ * @brief synthetic table where traffic mirror i is referred by i % 3 lanelets and every fifth one
+ * is invalid
+ *
+ */
+TrafficMirrorTable makeTable(const size_t n)
+{
+  TrafficMirrorTable table = traffic_mirror::synthetic::makeTrafficMirrorTable(n, 3);
+  table.lanelet_offsets = {0};
+  table.lanelet_ids.clear();
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < i % 3; ++j) {
+      table.lanelet_ids.push_back(static_cast<int64_t>(1000 + i * 10 + j));
+    }
+    table.lanelet_offsets.push_back(table.lanelet_ids.size());
+    table.is_valid[i] = i % 5 == 0 ? 0 : 1;
+  }
+  return table;
+}
+
+void expectEqual(const TrafficMirrorTable & table, const TrafficMirrorTable & expected)
+{
+  EXPECT_EQ(table.ids, expected.ids);
+  EXPECT_EQ(table.top_left_x, expected.top_left_x);
+  EXPECT_EQ(table.top_left_y, expected.top_left_y);
+  EXPECT_EQ(table.top_left_z, expected.top_left_z);
+  EXPECT_EQ(table.bottom_right_x, expected.bottom_right_x);
+  EXPECT_EQ(table.bottom_right_y, expected.bottom_right_y);
+  EXPECT_EQ(table.bottom_right_z, expected.bottom_right_z);
+  EXPECT_EQ(table.center_x, expected.center_x);
+  EXPECT_EQ(table.center_y, expected.center_y);
+  EXPECT_EQ(table.center_z, expected.center_z);
+  EXPECT_EQ(table.facing_x, expected.facing_x);
+  EXPECT_EQ(table.facing_y, expected.facing_y);
+  EXPECT_EQ(table.is_valid, expected.is_valid);
+  EXPECT_EQ(table.lanelet_offsets, expected.lanelet_offsets);
+  EXPECT_EQ(table.lanelet_ids, expected.lanelet_ids);
+}
+
+class TrafficMirrorCacheTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto * test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    cache_dir_ = std::filesystem::temp_directory_path() /
+                 (std::string("traffic_mirror_cache_") + test_info->name() + "_" +
+                  std::to_string(::getpid()));
+    path_ = traffic_mirror::makeTrafficMirrorCachePath(cache_dir_.string(), map_hash);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(cache_dir_); }
+
+  std::vector<char> readFile() const
+  {
+    std::ifstream file(path_, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), {});
+  }
+
+  void writeFile(const std::vector<char> & data) const
+  {
+    std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+
+  std::filesystem::path cache_dir_;
+  std::string path_;
+};
+
+TEST_F(TrafficMirrorCacheTest, ReadsWrittenTable)
+{
+  const TrafficMirrorTable expected = makeTable(100);
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, expected));
+  TrafficMirrorTable table;
+  ASSERT_TRUE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+  expectEqual(table, expected);
+}
+
+TEST_F(TrafficMirrorCacheTest, ReadsEmptyTable)
+{
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, TrafficMirrorTable{}));
+  TrafficMirrorTable table = makeTable(3);
+  ASSERT_TRUE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+  expectEqual(table, TrafficMirrorTable{});
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsMissingFile)
+{
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsOtherMap)
+{
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, makeTable(10)));
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash + 1, table));
+  EXPECT_EQ(table.size(), 0u);
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsOtherMagic)
+{
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, makeTable(10)));
+  std::vector<char> data = readFile();
+  data[0] ^= 1;
+  writeFile(data);
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsOtherVersion)
+{
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, makeTable(10)));
+  std::vector<char> data = readFile();
+  uint32_t version;
+  std::memcpy(&version, data.data() + version_offset, sizeof(version));
+  ++version;
+  std::memcpy(data.data() + version_offset, &version, sizeof(version));
+  writeFile(data);
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsTruncatedFile)
+{
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, makeTable(10)));
+  const std::vector<char> data = readFile();
+  // cut within the header, within the arrays and by the last byte
+  for (const size_t size : {size_t{4}, header_size + 8, data.size() - 1}) {
+    writeFile(std::vector<char>(data.begin(), data.begin() + size));
+    TrafficMirrorTable table;
+    EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table)) << size;
+  }
+  // nor is trailing data accepted
+  std::vector<char> extended = data;
+  extended.push_back(0);
+  writeFile(extended);
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+}
+
+TEST_F(TrafficMirrorCacheTest, RejectsUnsortedLaneletOffsets)
+{
+  const size_t n = 10;
+  const TrafficMirrorTable expected = makeTable(n);
+  ASSERT_TRUE(traffic_mirror::writeTrafficMirrorCache(path_, map_hash, expected));
+  std::vector<char> data = readFile();
+  // swap two different inner offsets, the first and the last ones stay valid
+  const size_t offsets_offset = header_size + per_mirror_array_num * n * sizeof(double);
+  const size_t i = 2;
+  ASSERT_LT(expected.lanelet_offsets[i], expected.lanelet_offsets[i + 1]);
+  std::swap_ranges(
+    data.begin() + offsets_offset + i * sizeof(uint64_t),
+    data.begin() + offsets_offset + (i + 1) * sizeof(uint64_t),
+    data.begin() + offsets_offset + (i + 1) * sizeof(uint64_t));
+  writeFile(data);
+  TrafficMirrorTable table;
+  EXPECT_FALSE(traffic_mirror::readTrafficMirrorCache(path_, map_hash, table));
+}
+}  // namespace
@@ -0,0 +1,341 @@
+// Copyright 2023 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "traffic_mirror_map_based_detector/detection_engine.hpp"
+#include "traffic_mirror_map_based_detector/detector_params.hpp"
+#include "traffic_mirror_map_based_detector/frame_inputs.hpp"
+#include "traffic_mirror_map_based_detector/spatial_grid.hpp"
+#include "traffic_mirror_map_based_detector/stage_metrics.hpp"
+#include "traffic_mirror_map_based_detector/traffic_mirror_map.hpp"
+
+#include <lanelet2_extension/utility/message_conversion.hpp>
+#include <lanelet2_extension/utility/query.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp/serialization.hpp>
+#include <rosbag2_cpp/reader.hpp>
+
+#include <autoware_auto_mapping_msgs/msg/had_map_bin.hpp>
+#include <autoware_planning_msgs/msg/lanelet_route.hpp>
+#include <sensor_msgs/msg/camera_info.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+
+#include <image_geometry/pinhole_camera_model.h>
+#include <tf2/buffer_core.h>
+#include <tf2/exceptions.h>
+
+#ifdef ROS_DISTRO_GALACTIC
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#else
+#include <tf2_geometry_msgs/tf2_geometry_msgs.hpp>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace traffic_mirror
+{
+/**
+ * @brief Runs the culling and the roi computation of the detector over the camera_info messages of
+ * a bag as fast as possible, with the tf of the bag in an in-memory buffer
+ *
+ */
+class Replay
+{
+public:
+  explicit Replay(rclcpp::Node & node) : node_(node)
+  {
+    bag_path_ = node.declare_parameter<std::string>("bag_path", "");
+    map_bag_path_ = node.declare_parameter<std::string>("map_bag_path", "");
+    camera_info_topic_ = node.declare_parameter<std::string>(
+      "camera_info_topic", "/sensing/camera/traffic_light/camera_info");
+    map_topic_ = node.declare_parameter<std::string>("map_topic", "/map/vector_map");
+    route_topic_ =
+      node.declare_parameter<std::string>("route_topic", "/planning/mission_planning/route");
+    use_route_ = node.declare_parameter<bool>("use_route", true);
+    roi_output_path_ = node.declare_parameter<std::string>("roi_output_path", "");
+    repeat_ = node.declare_parameter<int>("repeat", 1);
+
+    // the same parameters as the detector, so its parameter file can be passed as is
+    const DetectorParams params = declareDetectorParams(node);
+    config_ = params.detection;
+    sampling_ = params.sampling;
+    skip_unknown_route_primitives_ =
+      node.declare_parameter<bool>("skip_unknown_route_primitives", false);
+
+    if (repeat_ < 1) {
+      RCLCPP_ERROR_STREAM(
+        node_.get_logger(), "Invalid param repeat = " << repeat_ << ", set to default value = 1");
+      repeat_ = 1;
+    }
+    engine_ = DetectionEngine(config_);
+  }
+
+  bool run()
+  {
+    if (bag_path_.empty()) {
+      RCLCPP_ERROR(node_.get_logger(), "bag_path is not set");
+      return false;
+    }
+    if (!readBag(bag_path_, true) || (!map_bag_path_.empty() && !readBag(map_bag_path_, false))) {
+      return false;
+    }
+    if (!map_msg_) {
+      RCLCPP_ERROR(node_.get_logger(), "no map on %s", map_topic_.c_str());
+      return false;
+    }
+    if (!buildTrafficMirrors()) {
+      return false;
+    }
+
+    std::ofstream roi_output;
+    if (!roi_output_path_.empty()) {
+      roi_output.open(roi_output_path_);
+      if (!roi_output) {
+        RCLCPP_ERROR(node_.get_logger(), "cannot open %s", roi_output_path_.c_str());
+        return false;
+      }
+      roi_output << "# stamp_ns frame_id traffic_mirror_id rough_x rough_y rough_width "
+                    "rough_height expect_x expect_y expect_width expect_height\n";
+    }
+
+    LatencyHistogram latency;
+    size_t frame_num = 0;
+    size_t skipped_frame_num = 0;
+    size_t roi_num = 0;
+    // reused across the frames as the node does, so the latency does not include its allocation
+    std::vector<DetectedRoi> rois;
+    const auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < repeat_; ++pass) {
+      // the rois of every pass are the same, write them once
+      std::ofstream * output = pass == 0 && roi_output.is_open() ? &roi_output : nullptr;
+      for (const auto & camera_info : camera_info_msgs_) {
+        const auto frame_start = std::chrono::steady_clock::now();
+        rois.clear();
+        const bool has_pose = processCameraInfo(camera_info, rois);
+        const auto frame_end = std::chrono::steady_clock::now();
+        ++frame_num;
+        // a frame without tf returns early, it would pull the latency distribution down
+        if (!has_pose) {
+          ++skipped_frame_num;
+          continue;
+        }
+        latency.record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(frame_end - frame_start).count());
+        roi_num += rois.size();
+        if (output != nullptr) {
+          writeRois(camera_info, rois, *output);
+        }
+      }
+    }
+    const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto to_ms = [](const uint64_t ns) { return static_cast<double>(ns) * 1e-6; };
+    RCLCPP_INFO(
+      node_.get_logger(),
+      "replayed %lu frames (%lu without tf) in %.3f s: %.1f frames/s, %lu rois, latency of the "
+      "frames with tf p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms",
+      frame_num, skipped_frame_num, elapsed, elapsed > 0.0 ? frame_num / elapsed : 0.0, roi_num,
+      to_ms(latency.percentile(0.5)), to_ms(latency.percentile(0.9)),
+      to_ms(latency.percentile(0.99)), to_ms(latency.max()));
+    return true;
+  }
+
+private:
+  /**
+   * @brief Read the tf, the camera_info messages, the map and the route of a bag
+   *
+   * @param path               bag to read
+   * @param read_camera_info   false for a bag only read for its map and route
+   */
+  bool readBag(const std::string & path, const bool read_camera_info)
+  {
+    rosbag2_cpp::Reader reader;
+    try {
+      reader.open(path);
+    } catch (const std::exception & e) {
+      RCLCPP_ERROR(node_.get_logger(), "cannot open the bag %s: %s", path.c_str(), e.what());
+      return false;
+    }
+    if (read_camera_info) {
+      // keep every transform of the bag in memory, frames are not replayed in real time
+      tf_buffer_ = std::make_unique<tf2::BufferCore>(
+        std::chrono::duration_cast<tf2::Duration>(reader.get_metadata().duration) +
+        std::chrono::seconds(1));
+    }
+
+    rclcpp::Serialization<tf2_msgs::msg::TFMessage> tf_serialization;
+    rclcpp::Serialization<sensor_msgs::msg::CameraInfo> camera_info_serialization;
+    rclcpp::Serialization<autoware_auto_mapping_msgs::msg::HADMapBin> map_serialization;
+    rclcpp::Serialization<autoware_planning_msgs::msg::LaneletRoute> route_serialization;
+    while (reader.has_next()) {
+      const auto bag_msg = reader.read_next();
+      const rclcpp::SerializedMessage serialized_msg(*bag_msg->serialized_data);
+      const bool is_tf = bag_msg->topic_name == "/tf" || bag_msg->topic_name == "/tf_static";
+      if (read_camera_info && is_tf) {
+        tf2_msgs::msg::TFMessage tf_msg;
+        tf_serialization.deserialize_message(&serialized_msg, &tf_msg);
+        for (const auto & transform : tf_msg.transforms) {
+          tf_buffer_->setTransform(transform, "replay", bag_msg->topic_name == "/tf_static");
+        }
+      } else if (read_camera_info && bag_msg->topic_name == camera_info_topic_) {
+        sensor_msgs::msg::CameraInfo camera_info;
+        camera_info_serialization.deserialize_message(&serialized_msg, &camera_info);
+        camera_info_msgs_.push_back(std::move(camera_info));
+      } else if (bag_msg->topic_name == map_topic_) {
+        map_msg_.emplace();
+        map_serialization.deserialize_message(&serialized_msg, &*map_msg_);
+      } else if (bag_msg->topic_name == route_topic_) {
+        route_msg_.emplace();
+        route_serialization.deserialize_message(&serialized_msg, &*route_msg_);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Extract the traffic mirrors of the map, only those of the route lanelets if there is a
+   * route, as the detector does
+   *
+   */
+  bool buildTrafficMirrors()
+  {
+    const auto start = std::chrono::steady_clock::now();
+    auto lanelet_map = std::make_shared<lanelet::LaneletMap>();
+    lanelet::utils::conversion::fromBinMsg(*map_msg_, lanelet_map);
+    TrafficMirrorTable table =
+      buildTrafficMirrorTable(lanelet::utils::query::laneletLayer(lanelet_map));
+
+    if (use_route_ && route_msg_) {
+      std::unordered_set<lanelet::Id> route_lanelet_ids;
+      size_t missing_lanelet_num = 0;
+      if (!getRouteLaneletIds(
+            *lanelet_map, *route_msg_, skip_unknown_route_primitives_, node_.get_logger(),
+            route_lanelet_ids, missing_lanelet_num)) {
+        return false;
+      }
+      table = table.select(getLaneletTrafficMirrors(table, route_lanelet_ids));
+    }
+    traffic_mirrors_ = std::move(table);
+    grid_ = SpatialGrid(
+      traffic_mirrors_.center_x, traffic_mirrors_.center_y, config_.max_detection_range);
+    RCLCPP_INFO(
+      node_.get_logger(),
+      "map is loaded in %.3f s with %lu traffic mirrors%s, %lu camera_info messages to replay",
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+      traffic_mirrors_.size(), use_route_ && route_msg_ ? " on the route" : "",
+      camera_info_msgs_.size());
+    return true;
+  }
+
+  bool lookupTransform(const rclcpp::Time & t, const std::string & frame_id, tf2::Transform & tf)
+  {
+    try {
+      const geometry_msgs::msg::TransformStamped transform = tf_buffer_->lookupTransform(
+        "map", frame_id, tf2::TimePoint(std::chrono::nanoseconds(t.nanoseconds())));
+      tf2::fromMsg(transform.transform, tf);
+    } catch (const tf2::TransformException &) {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief the work of the detector for one camera_info message, without the publishing
+   *
+   * @return false  the camera pose is not in the bag
+   */
+  bool processCameraInfo(
+    const sensor_msgs::msg::CameraInfo & camera_info, std::vector<DetectedRoi> & rois)
+  {
+    if (
+      !pinhole_camera_model_.initialized() ||
+      !hasSameIntrinsics(pinhole_camera_model_.cameraInfo(), camera_info)) {
+      pinhole_camera_model_.fromCameraInfo(camera_info);
+      engine_.setCamera(
+        makeCameraIntrinsics(camera_info), makeRawProjection(pinhole_camera_model_));
+    }
+
+    const rclcpp::Time stamp(camera_info.header.stamp);
+    const std::string & frame_id = camera_info.header.frame_id;
+    tf2::Transform tf_map2camera;
+    if (!lookupTransform(stamp, frame_id, tf_map2camera)) {
+      return false;
+    }
+    std::vector<tf2::Transform> tf_map2camera_vec;
+    sampleTransforms(
+      sampling_, stamp, tf_map2camera,
+      [this, &frame_id](const rclcpp::Time & t, tf2::Transform & tf) {
+        return lookupTransform(t, frame_id, tf);
+      },
+      tf_map2camera_vec);
+    const PoseBundle poses = makePoseBundle(tf_map2camera, tf_map2camera_vec);
+    engine_.detect(traffic_mirrors_, grid_, poses, rois);
+    return true;
+  }
+
+  static void writeRois(
+    const sensor_msgs::msg::CameraInfo & camera_info, const std::vector<DetectedRoi> & rois,
+    std::ofstream & output)
+  {
+    const int64_t stamp = rclcpp::Time(camera_info.header.stamp).nanoseconds();
+    for (const auto & roi : rois) {
+      output << stamp << ' ' << camera_info.header.frame_id << ' ' << roi.traffic_mirror_id << ' '
+             << roi.rough_roi.x_offset << ' ' << roi.rough_roi.y_offset << ' '
+             << roi.rough_roi.width << ' ' << roi.rough_roi.height << ' '
+             << roi.expect_roi.x_offset << ' ' << roi.expect_roi.y_offset << ' '
+             << roi.expect_roi.width << ' ' << roi.expect_roi.height << '\n';
+    }
+  }
+
+  rclcpp::Node & node_;
+  std::string bag_path_;
+  std::string map_bag_path_;
+  std::string camera_info_topic_;
+  std::string map_topic_;
+  std::string route_topic_;
+  bool use_route_;
+  std::string roi_output_path_;
+  int repeat_;
+  DetectionConfig config_;
+  TimestampSampling sampling_;
+  bool skip_unknown_route_primitives_;
+
+  std::unique_ptr<tf2::BufferCore> tf_buffer_;
+  std::vector<sensor_msgs::msg::CameraInfo> camera_info_msgs_;
+  std::optional<autoware_auto_mapping_msgs::msg::HADMapBin> map_msg_;
+  std::optional<autoware_planning_msgs::msg::LaneletRoute> route_msg_;
+
+  TrafficMirrorTable traffic_mirrors_;
+  SpatialGrid grid_;
+  image_geometry::PinholeCameraModel pinhole_camera_model_;
+  DetectionEngine engine_;
+};
+}  // namespace traffic_mirror
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  const auto node = std::make_shared<rclcpp::Node>("traffic_mirror_map_based_detector_replay");
+  traffic_mirror::Replay replay(*node);
+  const bool succeeded = replay.run();
+  rclcpp::shutdown();
+  return succeeded ? 0 : 1;
+}